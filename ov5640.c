@@ -15,850 +15,83 @@
 #include "i2cdev.h"
 #include <linux/platform_device.h>
 #include <linux/i2c.h>
+#include <linux/ktime.h>
+#include <linux/firmware.h>
 #include "ov5640.h"
+#include "ov5640_programs.h"
 
 static u32 disable_nightmode = 0;
-module_param(disable_nightmode, uint, 0400);
+module_param(disable_nightmode, uint, 0644);
 MODULE_PARM_DESC(disable_nightmode, "Disable nightmode, default = 0 (enabled)");
 
+static u32 still_hold_frames = 2;
+module_param(still_hold_frames, uint, 0644);
+MODULE_PARM_DESC(still_hold_frames, "Still frames kept by IOCTL_CAM_GRAB_STILL before reverting to draft, default = 2");
 
-static int ov5640_initmipicamera(struct device *dev);
+static u32 ae_hold_frames = 2;
+module_param(ae_hold_frames, uint, 0644);
+MODULE_PARM_DESC(ae_hold_frames, "Frames AEC/AWB are held at the carried values after a mode switch, default = 2");
+
+
+static int ov5640_initmipicamera(struct device *dev, const struct ov5640_ae_state *ae);
 static int ov5640_initcsicamera(struct device *dev);
 static int ov5640_initcamera(struct device *dev);
 
-/* Definition of DT node name, construction is error prone, so avoiding some
- * error possibilities by using definition
- */
-#define VCAM_PARALLELL_INTERFACE "vcam_parallell_interface"
-
-static int ov5640_mirror_enable(struct device *dev, bool enable);
-static void ov5640_autofocus_enable(struct device *dev, bool enable);
-static int ov5640_set_fov(struct device *dev, int fov);
+struct ov5640_mode_timing;
 
-static int ov5640_set_sharpening(struct device *dev, int enable);
-static void ov5640_testpattern_enable(struct device *dev, unsigned char value);
-
-#define OV5640_SETTING_HIGH_K_ELEMENTS 93
-static struct reg_value ov5640_setting_High_K[OV5640_SETTING_HIGH_K_ELEMENTS] = {
-	{ 0x5180, 0xff },
-	{ 0x5181, 0xf2 },
-	{ 0x5182, 0x0 },
-	{ 0x5183, 0x14 },
-	{ 0x5184, 0x25 },
-	{ 0x5185, 0x24 },
-	{ 0x5186, 0x10 },
-	{ 0x5187, 0x10 },
-	{ 0x5188, 0x10 },
-	{ 0x5189, 0x6d },
-	{ 0x518a, 0x53 },
-	{ 0x518b, 0x90 },
-	{ 0x518c, 0x8c },
-	{ 0x518d, 0x3b },
-	{ 0x518e, 0x2c },
-	{ 0x518f, 0x59 },
-	{ 0x5190, 0x42 },
-	{ 0x5191, 0xf8 },
-	{ 0x5192, 0x4 },
-	{ 0x5193, 0x70 },
-	{ 0x5194, 0xf0 },
-	{ 0x5195, 0xf0 },
-	{ 0x5196, 0x3 },
-	{ 0x5197, 0x1 },
-	{ 0x5198, 0x4 },
-	{ 0x5199, 0x0 },
-	{ 0x519a, 0x4 },
-	{ 0x519b, 0x13 },
-	{ 0x519c, 0x6 },
-	{ 0x519d, 0x9e },
-	{ 0x519e, 0x38 },
-	{ 0x5800, 0x2a },
-	{ 0x5801, 0x1a },
-	{ 0x5802, 0x13 },
-	{ 0x5803, 0x13 },
-	{ 0x5804, 0x1b },
-	{ 0x5805, 0x2b },
-	{ 0x5806, 0x10 },
-	{ 0x5807, 0x9 },
-	{ 0x5808, 0x7 },
-	{ 0x5809, 0x7 },
-	{ 0x580a, 0xa },
-	{ 0x580b, 0x10 },
-	{ 0x580c, 0x8 },
-	{ 0x580d, 0x3 },
-	{ 0x580e, 0x0 },
-	{ 0x580f, 0x0 },
-	{ 0x5810, 0x4 },
-	{ 0x5811, 0x9 },
-	{ 0x5812, 0x9 },
-	{ 0x5813, 0x3 },
-	{ 0x5814, 0x0 },
-	{ 0x5815, 0x0 },
-	{ 0x5816, 0x4 },
-	{ 0x5817, 0x9 },
-	{ 0x5818, 0xd },
-	{ 0x5819, 0x6 },
-	{ 0x581a, 0x3 },
-	{ 0x581b, 0x4 },
-	{ 0x581c, 0x6 },
-	{ 0x581d, 0xd },
-	{ 0x581e, 0x21 },
-	{ 0x581f, 0x11 },
-	{ 0x5820, 0xa },
-	{ 0x5821, 0xa },
-	{ 0x5822, 0x13 },
-	{ 0x5823, 0x23 },
-	{ 0x5824, 0x13 },
-	{ 0x5825, 0x24 },
-	{ 0x5826, 0x24 },
-	{ 0x5827, 0x22 },
-	{ 0x5828, 0x4 },
-	{ 0x5829, 0x10 },
-	{ 0x582a, 0x22 },
-	{ 0x582b, 0x22 },
-	{ 0x582c, 0x22 },
-	{ 0x582d, 0x22 },
-	{ 0x582e, 0x10 },
-	{ 0x582f, 0x22 },
-	{ 0x5830, 0x42 },
-	{ 0x5831, 0x22 },
-	{ 0x5832, 0x22 },
-	{ 0x5833, 0x10 },
-	{ 0x5834, 0x22 },
-	{ 0x5835, 0x22 },
-	{ 0x5836, 0x22 },
-	{ 0x5837, 0x0 },
-	{ 0x5838, 0x12 },
-	{ 0x5839, 0x12 },
-	{ 0x583a, 0x10 },
-	{ 0x583b, 0x10 },
-	{ 0x583c, 0x2 },
-	{ 0x583d, 0xce },
+/* AEC/AGC and AWB state carried across mode switches */
+struct ov5640_ae_state {
+	const struct ov5640_mode_timing *timing;	/* mode it was read in */
+	u32 exposure;		/* 0x3500-0x3502, in 1/16 lines */
+	u16 gain;		/* 0x350a-0x350b, 1/16 steps */
+	u16 awb_gain[3];	/* 0x3400-0x3405, R G B */
 };
 
+static u32 still_fps;
+module_param(still_fps, uint, 0644);
+MODULE_PARM_DESC(still_fps, "5MP MIPI frame rate, 9 or 15, default = 0 (15 if vcam_mipi_max_mbps allows)");
 
-/*[11-14 17:20] Wistrand, Anders */
-/* @@ MEG5_YUV 1.875fps */
-/* 100 99 2592 1944 */
-/* 100 98 0 00 */
-/* 102 3601 bb */
-/* ; */
-/* ;OV5640 setting Version History */
-/* ;dated 04/08/2010 A02 */
-/* ;--Based on v08 release */
-/* ; */
-/* ;dated 04/20/2010 A03 */
-/* ;--Based on V10 release */
-/* ; */
-/* ;dated 04/22/2010 A04 */
-/* ;--Based on V10 release */
-/* ;--updated ccr & awb setting */
-/* ; */
-/* ;dated 04/22/2010 A06 */
-/* ;--Based on A05 release */
-/* ;--Add pg setting */
-/* ; */
-/* ;dated 05/19/2011 A09 */
-/* ;--changed pchg 3708 setting */
-/* ; */
-/* ;dated 07/06/2011 A10 */
-/* ;--changed contrast setting */
-/* ; */
-/* ;dated 07/11/2013 A11 */
-/* ;--change 3708/3709 align wt V15 */
-#define OV5640_INIT_SETTING_5MP_ELEMENTS 260
-
-static struct reg_value ov5640_init_setting_5MP[OV5640_INIT_SETTING_5MP_ELEMENTS] = {
-	{ 0x3103, 0x11 },
-	{ 0x3008, 0x82 },
-	{ 0x3008, 0x42 },
-	{ 0x3103, 0x03 },
-	{ 0x3017, 0xff },
-	{ 0x3018, 0xff },
-	{ 0x3034, 0x1a },
-	{ 0x3035, 0x21 },
-	{ 0x3036, 0x69 },
-	{ 0x3037, 0x13 },
-	{ 0x3108, 0x01 },
-	{ 0x3630, 0x36 },
-	{ 0x3631, 0x0e },
-	{ 0x3632, 0xe2 },
-	{ 0x3633, 0x12 },
-	{ 0x3621, 0xe0 },
-	{ 0x3704, 0xa0 },
-	{ 0x3703, 0x5a },
-	{ 0x3715, 0x78 },
-	{ 0x3717, 0x01 },
-	{ 0x370b, 0x60 },
-	{ 0x3705, 0x1a },
-	{ 0x3905, 0x02 },
-	{ 0x3906, 0x10 },
-	{ 0x3901, 0x0a },
-	{ 0x3731, 0x12 },
-	{ 0x3600, 0x08 },
-	{ 0x3601, 0x33 },
-	{ 0x302d, 0x60 },
-	{ 0x3620, 0x52 },
-	{ 0x371b, 0x20 },
-	{ 0x471c, 0x50 },
-	{ 0x3a13, 0x43 },
-	{ 0x3a18, 0x00 },
-	{ 0x3a19, 0xf8 },
-	{ 0x3635, 0x13 },
-	{ 0x3636, 0x03 },
-	{ 0x3634, 0x40 },
-	{ 0x3622, 0x01 },
-	{ 0x3c01, 0x34 },
-	{ 0x3c04, 0x28 },
-	{ 0x3c05, 0x98 },
-	{ 0x3c06, 0x00 },
-	{ 0x3c07, 0x07 },
-	{ 0x3c08, 0x00 },
-	{ 0x3c09, 0x1c },
-	{ 0x3c0a, 0x9c },
-	{ 0x3c0b, 0x40 },
-	{ 0x3821, 0x06 },
-	{ 0x3814, 0x11 },
-	{ 0x3815, 0x11 },
-	{ 0x3800, 0x00 },
-	{ 0x3801, 0x00 },
-	{ 0x3802, 0x00 },
-	{ 0x3803, 0x00 },
-	{ 0x3804, 0x0a },
-	{ 0x3805, 0x3f },
-	{ 0x3806, 0x07 },
-	{ 0x3807, 0x9f },
-	{ 0x3808, 0x0a },
-	{ 0x3809, 0x20 },
-	{ 0x380a, 0x07 },
-	{ 0x380b, 0x98 },
-	{ 0x380c, 0x0b },
-	{ 0x380d, 0x1c },
-	{ 0x380e, 0x07 },
-	{ 0x380f, 0xb0 },
-	{ 0x3810, 0x00 },
-	{ 0x3811, 0x10 },
-	{ 0x3812, 0x00 },
-	{ 0x3813, 0x04 },
-	{ 0x3618, 0x04 },
-	{ 0x3612, 0x2b },
-	{ 0x3708, 0x63 },
-	{ 0x3709, 0x12 },
-	{ 0x370c, 0x00 },
-	{ 0x3a02, 0x07 },
-	{ 0x3a03, 0xb0 },
-	{ 0x3a08, 0x01 },
-	{ 0x3a09, 0x27 },
-	{ 0x3a0a, 0x00 },
-	{ 0x3a0b, 0xf6 },
-	{ 0x3a0e, 0x06 },
-	{ 0x3a0d, 0x08 },
-	{ 0x3a14, 0x07 },
-	{ 0x3a15, 0xb0 },
-	{ 0x4001, 0x02 },
-	{ 0x4004, 0x06 },
-	{ 0x4050, 0x6e },
-	{ 0x4051, 0x8f },
-	{ 0x3000, 0x00 },
-	{ 0x3002, 0x1c },
-	{ 0x3004, 0xff },
-	{ 0x3006, 0xc3 },
-	{ 0x300e, 0x58 },
-	{ 0x302e, 0x00 },
-	{ 0x4300, 0x30 },
-	{ 0x4837, 0x2c },
-	{ 0x501f, 0x00 },
-	{ 0x5684, 0x0a },
-	{ 0x5685, 0x20 },
-	{ 0x5686, 0x07 },
-	{ 0x5687, 0x98 },
-	{ 0x440e, 0x00 },
-	{ 0x5000, 0xa7 },
-	{ 0x5001, 0x83 },
-	{ 0x5180, 0xff },
-	{ 0x5181, 0xf2 },
-	{ 0x5182, 0x00 },
-	{ 0x5183, 0x14 },
-	{ 0x5184, 0x25 },
-	{ 0x5185, 0x24 },
-	{ 0x5186, 0x09 },
-	{ 0x5187, 0x09 },
-	{ 0x5188, 0x09 },
-	{ 0x5189, 0x75 },
-	{ 0x518a, 0x54 },
-	{ 0x518b, 0xe0 },
-	{ 0x518c, 0xb2 },
-	{ 0x518d, 0x42 },
-	{ 0x518e, 0x3d },
-	{ 0x518f, 0x56 },
-	{ 0x5190, 0x46 },
-	{ 0x5191, 0xf8 },
-	{ 0x5192, 0x04 },
-	{ 0x5193, 0x70 },
-	{ 0x5194, 0xf0 },
-	{ 0x5195, 0xf0 },
-	{ 0x5196, 0x03 },
-	{ 0x5197, 0x01 },
-	{ 0x5198, 0x04 },
-	{ 0x5199, 0x12 },
-	{ 0x519a, 0x04 },
-	{ 0x519b, 0x00 },
-	{ 0x519c, 0x06 },
-	{ 0x519d, 0x82 },
-	{ 0x519e, 0x38 },
-	{ 0x5381, 0x1e },
-	{ 0x5382, 0x5b },
-	{ 0x5383, 0x08 },
-	{ 0x5384, 0x0a },
-	{ 0x5385, 0x7e },
-	{ 0x5386, 0x88 },
-	{ 0x5387, 0x7c },
-	{ 0x5388, 0x6c },
-	{ 0x5389, 0x10 },
-	{ 0x538a, 0x01 },
-	{ 0x538b, 0x98 },
-	{ 0x5300, 0x08 },
-	{ 0x5301, 0x30 },
-	{ 0x5302, 0x10 },
-	{ 0x5303, 0x00 },
-	{ 0x5304, 0x08 },
-	{ 0x5305, 0x30 },
-	{ 0x5306, 0x08 },
-	{ 0x5307, 0x16 },
-	{ 0x5309, 0x08 },
-	{ 0x530a, 0x30 },
-	{ 0x530b, 0x04 },
-	{ 0x530c, 0x06 },
-	{ 0x5480, 0x01 },
-	{ 0x5481, 0x08 },
-	{ 0x5482, 0x14 },
-	{ 0x5483, 0x28 },
-	{ 0x5484, 0x51 },
-	{ 0x5485, 0x65 },
-	{ 0x5486, 0x71 },
-	{ 0x5487, 0x7d },
-	{ 0x5488, 0x87 },
-	{ 0x5489, 0x91 },
-	{ 0x548a, 0x9a },
-	{ 0x548b, 0xaa },
-	{ 0x548c, 0xb8 },
-	{ 0x548d, 0xcd },
-	{ 0x548e, 0xdd },
-	{ 0x548f, 0xea },
-	{ 0x5490, 0x1d },
-	{ 0x5580, 0x02 },
-	{ 0x5583, 0x40 },
-	{ 0x5584, 0x10 },
-	{ 0x5589, 0x10 },
-	{ 0x558a, 0x00 },
-	{ 0x558b, 0xf8 },
-	{ 0x5800, 0x23 },
-	{ 0x5801, 0x14 },
-	{ 0x5802, 0x0f },
-	{ 0x5803, 0x0f },
-	{ 0x5804, 0x12 },
-	{ 0x5805, 0x26 },
-	{ 0x5806, 0x0c },
-	{ 0x5807, 0x08 },
-	{ 0x5808, 0x05 },
-	{ 0x5809, 0x05 },
-	{ 0x580a, 0x08 },
-	{ 0x580b, 0x0d },
-	{ 0x580c, 0x08 },
-	{ 0x580d, 0x03 },
-	{ 0x580e, 0x00 },
-	{ 0x580f, 0x00 },
-	{ 0x5810, 0x03 },
-	{ 0x5811, 0x09 },
-	{ 0x5812, 0x07 },
-	{ 0x5813, 0x03 },
-	{ 0x5814, 0x00 },
-	{ 0x5815, 0x01 },
-	{ 0x5816, 0x03 },
-	{ 0x5817, 0x08 },
-	{ 0x5818, 0x0d },
-	{ 0x5819, 0x08 },
-	{ 0x581a, 0x05 },
-	{ 0x581b, 0x06 },
-	{ 0x581c, 0x08 },
-	{ 0x581d, 0x0e },
-	{ 0x581e, 0x29 },
-	{ 0x581f, 0x17 },
-	{ 0x5820, 0x11 },
-	{ 0x5821, 0x11 },
-	{ 0x5822, 0x15 },
-	{ 0x5823, 0x28 },
-	{ 0x5824, 0x46 },
-	{ 0x5825, 0x26 },
-	{ 0x5826, 0x08 },
-	{ 0x5827, 0x26 },
-	{ 0x5828, 0x64 },
-	{ 0x5829, 0x26 },
-	{ 0x582a, 0x24 },
-	{ 0x582b, 0x22 },
-	{ 0x582c, 0x24 },
-	{ 0x582d, 0x24 },
-	{ 0x582e, 0x06 },
-	{ 0x582f, 0x22 },
-	{ 0x5830, 0x40 },
-	{ 0x5831, 0x42 },
-	{ 0x5832, 0x24 },
-	{ 0x5833, 0x26 },
-	{ 0x5834, 0x24 },
-	{ 0x5835, 0x22 },
-	{ 0x5836, 0x22 },
-	{ 0x5837, 0x26 },
-	{ 0x5838, 0x44 },
-	{ 0x5839, 0x24 },
-	{ 0x583a, 0x26 },
-	{ 0x583b, 0x28 },
-	{ 0x583c, 0x42 },
-	{ 0x583d, 0xce },
-	{ 0x5025, 0x00 },
-	{ 0x3a0f, 0x30 },
-	{ 0x3a10, 0x28 },
-	{ 0x3a1b, 0x30 },
-	{ 0x3a1e, 0x26 },
-	{ 0x3a11, 0x60 },
-	{ 0x3a1f, 0x14 },
-	{ 0x3008, 0x02 },
-	{ 0x471d, 0x00 }, //DVP VSYNC CTRL
-	{ 0x4740, 0x21 }, //DVP POLARITY CTRL00
-	{ 0x4300, 0x32 }, //FORMAT CONTROL b4:3 == 3 -> YUV422 -> b3:0 == 0x0 -> YUYV format
-	{ 0x501f, 0x00 }, //FORMAT MUX CONTROL (Foramt select, b2:0 == 0 -> ISP YUV422
-	{ 0x3820, 0x47 }, //VFLIP
-	{ 0x3035, 0x21 },
-	{ 0x3821, 0x01 }, //MIRROR
-};
+static char *af_firmware = OV5640_AF_FW_NAME;
+module_param(af_firmware, charp, 0444);
+MODULE_PARM_DESC(af_firmware, "AF MCU firmware file, default = " OV5640_AF_FW_NAME);
+MODULE_FIRMWARE(OV5640_AF_FW_NAME);
 
-/* Settings from
- * Rocky/Elektronik/Komponenter/datablad/VCam/Settings/
- */
-#define OV5640_INIT_SETTING_9FPS_5MP_ELEMENTS 252
-static struct reg_value ov5640_init_setting_9fps_5MP[OV5640_INIT_SETTING_9FPS_5MP_ELEMENTS] = {
-	{ 0x3103, 0x11 },
-	{ 0x3008, 0x82 },
-	{ 0x3008, 0x42 },
-	{ 0x3103, 0x03 },
-	{ 0x3017, 0x00 },
-	{ 0x3018, 0x00 },
-	{ 0x3034, 0x18 },
-	{ 0x3035, 0x11 },
-	{ 0x3036, 0x34 },
-	{ 0x3037, 0x13 },
-	{ 0x3108, 0x01 },
-	{ 0x3630, 0x36 },
-	{ 0x3631, 0x0e },
-	{ 0x3632, 0xe2 },
-	{ 0x3633, 0x12 },
-	{ 0x3621, 0xe0 },
-	{ 0x3704, 0xa0 },
-	{ 0x3703, 0x5a },
-	{ 0x3715, 0x78 },
-	{ 0x3717, 0x01 },
-	{ 0x370b, 0x60 },
-	{ 0x3705, 0x1a },
-	{ 0x3905, 0x02 },
-	{ 0x3906, 0x10 },
-	{ 0x3901, 0x0a },
-	{ 0x3731, 0x12 },
-	{ 0x3600, 0x08 },
-	{ 0x3601, 0x33 },
-	{ 0x302d, 0x60 },
-	{ 0x3620, 0x52 },
-	{ 0x371b, 0x20 },
-	{ 0x471c, 0x50 },
-	{ 0x3a13, 0x43 },
-	{ 0x3a17, 0x03 },
-	{ 0x3a18, 0x03 },
-	{ 0x3a19, 0xc0 },	// Changed from ff to c0 by IQL
-	{ 0x3635, 0x13 },
-	{ 0x3636, 0x03 },
-	{ 0x3634, 0x40 },
-	{ 0x3622, 0x01 },
-	{ 0x3c01, 0x34 },
-	{ 0x3c04, 0x28 },
-	{ 0x3c05, 0x98 },
-	{ 0x3c06, 0x00 },
-	{ 0x3c07, 0x07 },
-	{ 0x3c08, 0x00 },
-	{ 0x3c09, 0x1c },
-	{ 0x3c0a, 0x9c },
-	{ 0x3c0b, 0x40 },
-	{ 0x3820, 0x40 },	//Sensor flip=0 and mirror=1
-	{ 0x3821, 0x07 },
-	{ 0x3814, 0x11 },
-	{ 0x3815, 0x11 },
-	{ 0x3800, 0x00 },
-	{ 0x3801, 0x00 },
-	{ 0x3802, 0x00 },
-	{ 0x3803, 0x00 },
-	{ 0x3804, 0x0a },
-	{ 0x3805, 0x3f },
-	{ 0x3806, 0x07 },
-	{ 0x3807, 0x9f },
-	{ 0x3808, 0x0a },
-	{ 0x3809, 0x20 },
-	{ 0x380a, 0x07 },
-	{ 0x380b, 0x98 },
-	{ 0x380c, 0x0b },
-	{ 0x380d, 0x1c },
-	{ 0x380e, 0x07 },
-	{ 0x380f, 0xb0 },
-	{ 0x3810, 0x00 },
-	{ 0x3811, 0x10 },
-	{ 0x3812, 0x00 },
-	{ 0x3813, 0x04 },
-	{ 0x3618, 0x04 },
-	{ 0x3612, 0x2b },
-	{ 0x3708, 0x64 },
-	{ 0x3709, 0x12 },
-	{ 0x370c, 0x00 },
-	{ 0x3a00, 0x7c },	//night_mode
-	{ 0x3a01, 0x01 },
-	{ 0x3a02, 0x0f },
-	{ 0x3a03, 0xff },
-	{ 0x3a05, 0x70 },	//Sigma change from 30 to 70 (161130)
-	{ 0x3a08, 0x01 },
-	{ 0x3a09, 0x27 },
-	{ 0x3a0a, 0x00 },
-	{ 0x3a0b, 0xf6 },
-	{ 0x3a0e, 0x06 },
-	{ 0x3a0d, 0x08 },
-	{ 0x3a14, 0xff },
-	{ 0x3a15, 0xff },
-	{ 0x4001, 0x02 },
-	{ 0x4004, 0x06 },
-	{ 0x3000, 0x20 },	//Leave MCU in reset
-	{ 0x3002, 0x1c },
-	{ 0x3004, 0xdf },	//Disable mcu clock
-	{ 0x3006, 0xc3 },
-	{ 0x300e, 0x45 },	/* MIPI enabled */
-	{ 0x302e, 0x08 },
-	{ 0x4300, 0x32 },
-	{ 0x4837, 0x0a },
-	{ 0x501f, 0x00 },
-	{ 0x440e, 0x00 },
-	{ 0x5000, 0xa7 },
-	{ 0x5001, 0x83 },
-	{ 0x5180, 0xff },
-	{ 0x5181, 0xf2 },
-	{ 0x5182, 0x00 },
-	{ 0x5183, 0x14 },	// [START] Sigma AWB tuning (advanced mode 0x14) (161121)
-	{ 0x5184, 0x25 },	//
-	{ 0x5185, 0x24 },	//
-	{ 0x5186, 0x0b },	//
-	{ 0x5187, 0x0f },	//
-	{ 0x5188, 0x0c },	//
-	{ 0x5189, 0x72 },	//
-	{ 0x518a, 0x63 },	//
-	{ 0x518b, 0xbb },	//
-	{ 0x518c, 0x8c },	//
-	{ 0x518d, 0x3c },	//
-	{ 0x518e, 0x3c },	//
-	{ 0x518f, 0x48 },	//
-	{ 0x5190, 0x45 },	//
-	{ 0x5191, 0xf8 },	//
-	{ 0x5192, 0x04 },	//
-	{ 0x5193, 0x70 },	//
-	{ 0x5194, 0xf0 },	//
-	{ 0x5195, 0xf0 },	//
-	{ 0x5196, 0x03 },	//
-	{ 0x5197, 0x01 },	//
-	{ 0x5198, 0x06 },	//
-	{ 0x5199, 0x9b },	//
-	{ 0x519a, 0x04 },	//
-	{ 0x519b, 0x00 },	//
-	{ 0x519c, 0x04 },	//
-	{ 0x519d, 0x14 },	//
-	{ 0x519e, 0x38 },	// [END] Sigma AWB tuning (advanced mode 0x14) (161121)
-	{ 0x5381, 0x1e },	// [START] Sigma roll back to default CCM, to be finished (161121)
-	{ 0x5382, 0x5b },	//
-	{ 0x5383, 0x08 },	//
-	{ 0x5384, 0x0a },	//
-	{ 0x5385, 0x7e },	//
-	{ 0x5386, 0x88 },	//
-	{ 0x5387, 0x7c },	//
-	{ 0x5388, 0x6c },	//
-	{ 0x5389, 0x10 },	//
-	{ 0x538a, 0x01 },	//
-	{ 0x538b, 0x98 },	// [START] Sigma roll back to default CCM, to be finished (161121)
-	{ 0x5300, 0x08 },
-	{ 0x5301, 0x30 },
-	{ 0x5302, 0x10 },
-	{ 0x5303, 0x00 },
-	{ 0x5304, 0x08 },
-	{ 0x5305, 0x30 },
-	{ 0x5306, 0x08 },
-	{ 0x5307, 0x16 },
-	{ 0x5309, 0x08 },
-	{ 0x530a, 0x30 },
-	{ 0x530b, 0x04 },
-	{ 0x530c, 0x06 },
-	{ 0x5480, 0x01 },
-	{ 0x5481, 0x1f },	// [START] Sigma gamma settings (161130)
-	{ 0x5482, 0x2a },	//
-	{ 0x5483, 0x3c },	//
-	{ 0x5484, 0x61 },	//
-	{ 0x5485, 0x73 },	//
-	{ 0x5486, 0x7e },	//
-	{ 0x5487, 0x88 },	//
-	{ 0x5488, 0x91 },	//
-	{ 0x5489, 0x9a },	//
-	{ 0x548a, 0xa2 },	//
-	{ 0x548b, 0xb1 },	//
-	{ 0x548c, 0xbd },	//
-	{ 0x548d, 0xd0 },	//
-	{ 0x548e, 0xdf },	//
-	{ 0x548f, 0xea },	//
-	{ 0x5490, 0x1d },	// [END] Sigma gamma settings (161130)
-	{ 0x5580, 0x02 },
-	{ 0x5583, 0x40 },
-	{ 0x5584, 0x10 },
-	{ 0x5589, 0x10 },
-	{ 0x558a, 0x00 },
-	{ 0x558b, 0xf8 },
-	{ 0x5800, 0x23 },	// [START] Sigma LENC table (161121)
-	{ 0x5801, 0x14 },	//
-	{ 0x5802, 0x0f },	//
-	{ 0x5803, 0x0f },	//
-	{ 0x5804, 0x12 },	//
-	{ 0x5805, 0x26 },	//
-	{ 0x5806, 0x0c },	//
-	{ 0x5807, 0x08 },	//
-	{ 0x5808, 0x07 },	//
-	{ 0x5809, 0x07 },	//
-	{ 0x580a, 0x08 },	//
-	{ 0x580b, 0x0d },	//
-	{ 0x580c, 0x08 },	//
-	{ 0x580d, 0x03 },	//
-	{ 0x580e, 0x01 },	//
-	{ 0x580f, 0x01 },	//
-	{ 0x5810, 0x07 },	//
-	{ 0x5811, 0x09 },	//
-	{ 0x5812, 0x07 },	//
-	{ 0x5813, 0x03 },	//
-	{ 0x5814, 0x01 },	//
-	{ 0x5815, 0x01 },	//
-	{ 0x5816, 0x07 },	//
-	{ 0x5817, 0x08 },	//
-	{ 0x5818, 0x0d },	//
-	{ 0x5819, 0x08 },	//
-	{ 0x581a, 0x05 },	//
-	{ 0x581b, 0x06 },	//
-	{ 0x581c, 0x08 },	//
-	{ 0x581d, 0x0e },	//
-	{ 0x581e, 0x29 },	//
-	{ 0x581f, 0x17 },	//
-	{ 0x5820, 0x11 },	//
-	{ 0x5821, 0x11 },	//
-	{ 0x5822, 0x15 },	//
-	{ 0x5823, 0x28 },	//
-	{ 0x5824, 0x46 },	//
-	{ 0x5825, 0x26 },	//
-	{ 0x5826, 0x08 },	//
-	{ 0x5827, 0x26 },	//
-	{ 0x5828, 0x64 },	//
-	{ 0x5829, 0x26 },	//
-	{ 0x582a, 0x24 },	//
-	{ 0x582b, 0x21 },	//
-	{ 0x582c, 0x02 },	//
-	{ 0x582d, 0x24 },	//
-	{ 0x582e, 0x06 },	//
-	{ 0x582f, 0x21 },	//
-	{ 0x5830, 0x30 },	//
-	{ 0x5831, 0x21 },	//
-	{ 0x5832, 0x24 },	//
-	{ 0x5833, 0x26 },	//
-	{ 0x5834, 0x24 },	//
-	{ 0x5835, 0x21 },	//
-	{ 0x5836, 0x22 },	//
-	{ 0x5837, 0x26 },	//
-	{ 0x5838, 0x44 },	//
-	{ 0x5839, 0x24 },	//
-	{ 0x583a, 0x26 },	//
-	{ 0x583b, 0x28 },	//
-	{ 0x583c, 0x42 },	//
-	{ 0x583d, 0xff },	// [END] Sigma LENC table (161121)
-	{ 0x5025, 0x00 },
-	{ 0x3a0f, 0x30 },	// Exposure target
-	{ 0x3a10, 0x28 },	//
-	{ 0x3a1b, 0x30 },	//
-	{ 0x3a1e, 0x26 },	//
-	{ 0x3a11, 0x60 },
-	{ 0x3a1f, 0x14 },
-	{ 0x3008, 0x02 }
-};
+static int ov5640_mirror_enable(struct device *dev, bool enable);
+static int ov5640_autofocus_enable(struct device *dev, bool enable);
+static int ov5640_set_fov(struct device *dev, int fov, const struct ov5640_ae_state *ae);
+static int ov5640_set_still_format(struct device *dev);
+static int ov5640_set_output_format(struct device *dev, VCAM_OutputFormat fmt);
+static const struct ov5640_ae_state *ov5640_capture_ae(struct device *dev, struct ov5640_ae_state *ae);
 
-static struct reg_value ov5640_edge_enhancement = { 0x5302, 0x24 };	// Sigma increase edge enhancement from 10 to 24 (161025)
+static int ov5640_set_sharpening(struct device *dev, int enable);
 
-/*
- * settings based on ov5640_setting_30fps_720P_1280_720
- *
- * mode timings from https://confluence-se.flir.net/display/IN/vcam+modes
- *
- * vcam fov=55 used with IR lens fov=45
- */
-#define OV5640_SETTING_30FPS_1280_960_HFOV54_ELEMENTS 75
-static struct reg_value ov5640_setting_30fps_1280_960_HFOV54[OV5640_SETTING_30FPS_1280_960_HFOV54_ELEMENTS] = {
-	{ 0x3008, 0x42 },
-	{ 0x3035, 0x21 }, { 0x3036, 0x5c }, { 0x3c07, 0x07 },
-	{ 0x3c09, 0x1c }, { 0x3c0a, 0x9c }, { 0x3c0b, 0x40 },
-	{ 0x3814, 0x31 },	//Horizontal subsamble increment
-	{ 0x3815, 0x31 },	//Vertical   subsamble increment
-	{ 0x3800, 0x00 }, { 0x3801, 0x00 },	//X address start = 0x0
-	{ 0x3802, 0x00 }, { 0x3803, 0x04 },	//Y address start = 0x4
-	{ 0x3804, 0x0a }, { 0x3805, 0x3f },	//X address end   = 0xa3f
-	{ 0x3806, 0x07 }, { 0x3807, 0x9b },	//Y address end   = 0x79b
-	{ 0x3808, 0x05 }, { 0x3809, 0x00 },	//DVP width  output size = 0x500   (1280)
-	{ 0x380a, 0x03 }, { 0x380b, 0xc0 },	//DVP height output size = 0x3c0   (960)
-	{ 0x380c, 0x06 }, { 0x380d, 0x40 },	// Total horizontal size = 0x640   ()
-	{ 0x380e, 0x03 }, { 0x380f, 0xd8 },	// Total vertical size  =  0x3d8   (984)
-	{ 0x3810, 0x00 }, { 0x3811, 0x10 },	// ISP horizontal offset = 0x10
-	{ 0x3812, 0x00 }, { 0x3813, 0x00 },	// ISP vertical   offset = 0x0
-	{ 0x3618, 0x00 }, { 0x3612, 0x29 }, { 0x3708, 0x64 },
-	{ 0x3709, 0x52 }, { 0x370c, 0x03 }, { 0x3a02, 0x0f },
-	{ 0x3a03, 0xff }, { 0x3a08, 0x01 }, { 0x3a09, 0xbc },
-	{ 0x3a0a, 0x01 }, { 0x3a0b, 0x72 }, { 0x3a0e, 0x06 },
-	{ 0x3a0d, 0x02 }, { 0x3a14, 0x0f }, { 0x3a15, 0xff },
-	{ 0x4001, 0x02 }, { 0x4004, 0x02 }, { 0x4713, 0x02 },
-	{ 0x4407, 0x04 }, { 0x460b, 0x37 }, { 0x460c, 0x20 },
-	{ 0x3824, 0x04 }, { 0x5001, 0x83 }, { 0x4005, 0x1a },
-	{ 0x3008, 0x02 }, { 0x3503, 0 },
-	{ 0x5688, 0x11 },	// [START] Sigma exposure weights (161130)
-	{ 0x5689, 0x11 },	// keep 0x11 for HFOV28 and HFOV39
-	{ 0x568a, 0x11 },	//
-	{ 0x568b, 0x11 },	//
-	{ 0x568c, 0x11 },	//
-	{ 0x568d, 0x11 },	//
-	{ 0x568e, 0x11 },	//
-	{ 0x568f, 0x11 },	// [END] Sigma exposure weights (161130)
-	{ 0x5186, 0x0b },	// [START] Sigma HFOV54/HFOV28 AWB (161202)
-	{ 0x5187, 0x0f },	//
-	{ 0x5188, 0x0c },	//
-	{ 0x5189, 0x72 },	//
-	{ 0x518a, 0x63 },	//
-	{ 0x518e, 0x3c },	//
-	{ 0x518f, 0x48 },	//
-	{ 0x5190, 0x45 },	//
-	{ 0x5198, 0x06 },	//
-	{ 0x5199, 0x9b },	//
-	{ 0x519c, 0x04 },	//
-	{ 0x519d, 0x14 },	// [END] Sigma HFOV54/HFOV28 AWB (161202)
-};
+static struct reg_value ov5640_edge_enhancement = { 0x5302, 0x24 };	// Sigma increase edge enhancement from 10 to 24 (161025)
 
 /*
- *
- *
- * settings based on ov5640_setting_30fps_720P_1280_720
- *
- * mode timings from https://confluence-se.flir.net/display/IN/vcam+modes
- *
- * vcam fov=39 used with IR lens fov=28
- */
-#define OV5640_SETTING_30FPS_1280_960_HFOV39_ELEMENTS 75
-static struct reg_value ov5640_setting_30fps_1280_960_HFOV39[OV5640_SETTING_30FPS_1280_960_HFOV39_ELEMENTS] = {
-	{ 0x3008, 0x42 },
-	{ 0x3035, 0x12 }, { 0x3036, 0x60 }, { 0x3c07, 0x07 },
-	{ 0x3c09, 0x1c }, { 0x3c0a, 0x9c }, { 0x3c0b, 0x40 },
-	{ 0x3814, 0x11 },	//Horizontal subsamble increment
-	{ 0x3815, 0x11 },	//Vertical   subsamble increment
-	{ 0x3800, 0x01 }, { 0x3801, 0x8c },	//X address start = 0x18c
-	{ 0x3802, 0x01 }, { 0x3803, 0x26 },	//Y address start = 0x126
-	{ 0x3804, 0x08 }, { 0x3805, 0xb3 },	//X address end   = 0x8b3
-	{ 0x3806, 0x06 }, { 0x3807, 0x77 },	//Y address end   = 0x677
-	{ 0x3808, 0x05 }, { 0x3809, 0x00 },	//DVP width  output size = 0x500   (1280)
-	{ 0x380a, 0x03 }, { 0x380b, 0xc0 },	//DVP height output size = 0x3c0   (960)
-	{ 0x380c, 0x08 }, { 0x380d, 0x00 },	// Total horizontal size = 0x800   (2048)
-	{ 0x380e, 0x06 }, { 0x380f, 0x00 },	// Total vertical size  =  0x600   (1536)
-	{ 0x3810, 0x00 }, { 0x3811, 0x10 },	// ISP horizontal offset = 0x10
-	{ 0x3812, 0x00 }, { 0x3813, 0x06 },	// ISP vertical   offset = 0x6
-	{ 0x3618, 0x00 }, { 0x3612, 0x29 }, { 0x3708, 0x64 },
-	{ 0x3709, 0x52 }, { 0x370c, 0x03 }, { 0x3a02, 0x0f },
-	{ 0x3a03, 0xff }, { 0x3a08, 0x01 }, { 0x3a09, 0xbc },
-	{ 0x3a0a, 0x01 }, { 0x3a0b, 0x72 }, { 0x3a0e, 0x06 },
-	{ 0x3a0d, 0x02 }, { 0x3a14, 0x0f }, { 0x3a15, 0xff },
-	{ 0x4001, 0x02 }, { 0x4004, 0x02 }, { 0x4713, 0x02 },
-	{ 0x4407, 0x04 }, { 0x460b, 0x37 }, { 0x460c, 0x20 },
-	{ 0x3824, 0x04 }, { 0x5001, 0xa3 }, { 0x4005, 0x1a },
-	{ 0x3008, 0x02 }, { 0x3503, 0 },
-	{ 0x5688, 0x11 },	// [START] Sigma exposure weights (161130)
-	{ 0x5689, 0x11 },	// keep 0x11 for HFOV28 and HFOV39
-	{ 0x568a, 0x11 },	//
-	{ 0x568b, 0x11 },	//
-	{ 0x568c, 0x11 },	//
-	{ 0x568d, 0x11 },	//
-	{ 0x568e, 0x11 },	//
-	{ 0x568f, 0x11 },	// [END] Sigma exposure weights (161130)
-	{ 0x5186, 0x10 },	// [START] Sigma HFOV39 AWB (161202)
-	{ 0x5187, 0x14 },	//
-	{ 0x5188, 0x10 },	//
-	{ 0x5189, 0x7d },	//
-	{ 0x518a, 0x6b },	//
-	{ 0x518e, 0x3a },	//
-	{ 0x518f, 0x4d },	//
-	{ 0x5190, 0x47 },	//
-	{ 0x5198, 0x04 },	//
-	{ 0x5199, 0x4d },	//
-	{ 0x519c, 0x08 },	//
-	{ 0x519d, 0x82 },	// [END] Sigma HFOV39 AWB (161202)
+ * Nominal frame timing of each mode, used to convert exposure between
+ * modes and to know how long a frame takes. fov 0 is the 5MP still mode.
+ */
+#define OV5640_IF_ANY	0
+#define OV5640_IF_MIPI	1
+#define OV5640_IF_DVP	2
+
+struct ov5640_mode_timing {
+	int fov;
+	unsigned int fps;
+	unsigned int vts;	/* total lines per frame, 0x380e/0x380f */
+	unsigned int bin;	/* pixels summed per output pixel, 0x3814/0x3821 */
+	bool isp_scaled;	/* output scaled in the ISP, 0x5001 bit 5 */
+	int iface;		/* OV5640_IF_* the timing applies to */
 };
 
-/*
- *
- *
- * settings based on ov5640_setting_30fps_720P_1280_720
- *
- * mode timings from https://confluence-se.flir.net/display/IN/vcam+modes
- *
- * vcam fov=28 used with IR lens fov=12
- *
- */
-#define OV5640_SETTING_30FPS_1280_960_HFOV28_ELEMENTS 75
-static struct reg_value ov5640_setting_30fps_1280_960_HFOV28[OV5640_SETTING_30FPS_1280_960_HFOV28_ELEMENTS] = {
-	{ 0x3008, 0x42 },
-	{ 0x3035, 0x21 }, { 0x3036, 0x5c }, { 0x3c07, 0x07 },
-	{ 0x3c09, 0x1c }, { 0x3c0a, 0x9c }, { 0x3c0b, 0x40 },
-	{ 0x3814, 0x11 },	//Horizontal subsamble increment
-	{ 0x3815, 0x11 },	//Vertical   subsamble increment
-	{ 0x3800, 0x02 }, { 0x3801, 0x90 },	//X address start = 0x290
-	{ 0x3802, 0x01 }, { 0x3803, 0xec },	//Y address start = 0x1ec
-	{ 0x3804, 0x07 }, { 0x3805, 0xaf },	//X address end   = 0x7af
-	{ 0x3806, 0x05 }, { 0x3807, 0xb3 },	//Y address end   = 0x5b3
-	{ 0x3808, 0x05 }, { 0x3809, 0x00 },	//DVP width  output size = 0x500   (1280)
-	{ 0x380a, 0x03 }, { 0x380b, 0xc0 },	//DVP height output size = 0x3c0   (960)
-	{ 0x380c, 0x06 }, { 0x380d, 0x00 },	// Total horizontal size = 0x600   (1536)
-	{ 0x380e, 0x03 }, { 0x380f, 0xd8 },	// Total vertical size  =  0x3d8   (984)
-	{ 0x3810, 0x00 }, { 0x3811, 0x10 },	// ISP horizontal offset = 0x10
-	{ 0x3812, 0x00 }, { 0x3813, 0x04 },	// ISP vertical   offset = 0x4
-	{ 0x3618, 0x00 }, { 0x3612, 0x29 }, { 0x3708, 0x64 },
-	{ 0x3709, 0x52 }, { 0x370c, 0x03 }, { 0x3a02, 0x0f },
-	{ 0x3a03, 0xff }, { 0x3a08, 0x01 }, { 0x3a09, 0xbc },
-	{ 0x3a0a, 0x01 }, { 0x3a0b, 0x72 }, { 0x3a0e, 0x06 },
-	{ 0x3a0d, 0x02 }, { 0x3a14, 0x0f }, { 0x3a15, 0xff },
-	{ 0x4001, 0x02 }, { 0x4004, 0x02 }, { 0x4713, 0x02 },
-	{ 0x4407, 0x04 }, { 0x460b, 0x37 }, { 0x460c, 0x20 },
-	{ 0x3824, 0x04 }, { 0x5001, 0x83 }, { 0x4005, 0x1a },
-	{ 0x3008, 0x02 }, { 0x3503, 0 },
-	{ 0x5688, 0x33 },	// [START] Sigma exposure weights (161130)
-	{ 0x5689, 0x33 },	// Tuned for HFOV54
-	{ 0x568a, 0x53 },	//
-	{ 0x568b, 0x35 },	//
-	{ 0x568c, 0x53 },	//
-	{ 0x568d, 0x35 },	//
-	{ 0x568e, 0x33 },	//
-	{ 0x568f, 0x33 },	// [END] Sigma exposure weights (161130)
-	{ 0x5186, 0x0b },	// [START] Sigma HFOV54/HFOV28 AWB (161202)
-	{ 0x5187, 0x0f },	//
-	{ 0x5188, 0x0c },	//
-	{ 0x5189, 0x72 },	//
-	{ 0x518a, 0x63 },	//
-	{ 0x518e, 0x3c },	//
-	{ 0x518f, 0x48 },	//
-	{ 0x5190, 0x45 },	//
-	{ 0x5198, 0x06 },	//
-	{ 0x5199, 0x9b },	//
-	{ 0x519c, 0x04 },	//
-	{ 0x519d, 0x14 },	// [END] Sigma HFOV54/HFOV28 AWB (161202)
+static const struct ov5640_mode_timing ov5640_mode_timings[] = {
+	{ 54, 30, 0x3d8, 2, false, OV5640_IF_ANY },
+	{ 39, 30, 0x600, 1, true, OV5640_IF_MIPI },
+	{ 39, 15, 0x600, 1, true, OV5640_IF_DVP },
+	{ 28, 30, 0x3d8, 1, false, OV5640_IF_ANY },
+	{ 0, 9, 0x7b0, 1, false, OV5640_IF_MIPI },
+	{ 0, 15, 0x7b0, 1, false, OV5640_IF_MIPI },
+	{ 0, OV5640_DVP_5MP_FPS, 0x7b0, 1, false, OV5640_IF_DVP },
 };
 
 static struct reg_value stream_on = { 0x4202, 0x00 };	//stream on
@@ -874,184 +107,84 @@ static struct reg_value ov5640_sharpening_off_reg = { 0x5308, 0x40 };
 
 static struct reg_value night_mode_on = { 0x3a00, 0x7c };
 static struct reg_value night_mode_off = { 0x3a00, 0x78 };
-static struct reg_value autofocus_on = { 0x3022, 0x04 };
-static struct reg_value autofocus_off = { 0x3022, 0x00 };
 
-static int g_vcamFOV = 54;
-
-/* OV5640 Configurations copied from WINCE Gas Camera */
-/*
- * General initialization executed once at power on
- *
- *
- */
-#define OV5640_INIT_INTERFACE_CSI_ELEMENTS 212
-static struct reg_value ov5640_init_interface_csi[OV5640_INIT_INTERFACE_CSI_ELEMENTS] = {
-	{0x3103, 0x11}, //SCCB system control
-	{0x3008, 0x42}, //System root divider
-	{0x3103, 0x03}, //SCCB system control
-	{0x3017, 0xff}, //VSYNC I/O control
-	{0x3018, 0xff}, //Pad output enable
-	{0x3034, 0x1a}, //SC PLL control
-	{0x3035, 0x21}, //System clock divider
-	{0x3037, 0x13}, //PLL pre-divider
-	{0x3108, 0x01}, //System root divider
-	{0x302d, 0x60}, //System control
-
-	{0x3630, 0x36}, {0x3631, 0x0e}, //undoc start
-	{0x3632, 0xe2}, {0x3633, 0x12},
-	{0x3621, 0xe0}, {0x3704, 0xa0},
-	{0x3703, 0x5a}, {0x3715, 0x78},
-	{0x3717, 0x01}, {0x370b, 0x60},
-	{0x3705, 0x1a}, {0x3905, 0x02},
-	{0x3906, 0x10}, {0x3901, 0x0a},
-	{0x3731, 0x12}, {0x3620, 0x52},
-	{0x371b, 0x20}, {0x3635, 0x13},
-	{0x3636, 0x03}, {0x3634, 0x40},
-	{0x3622, 0x01}, {0x471c, 0x50},
-	{0x4050, 0x6e}, {0x4051, 0x8f},
-	{0x302e, 0x00}, {0x5025, 0x00},
-
-	{0x3824, 0x06}, //[AW change 02 to 06] PCLK divider
-	{0x3a13, 0x43}, //AEC ctrl
-	{0x3a18, 0x00}, {0x3a19, 0xf8}, //AEC Gain ceiling
-
-	{0x3c01, 0x34}, {0x3c05, 0x98}, //5060HZ ctrl
-	{0x3c06, 0x00}, {0x3c08, 0x00},
-	{0x3c09, 0x1c}, {0x3c0a, 0x9c},
-	{0x3c0b, 0x40},
-
-	{0x3820, 0x47}, //VFLIP
-	{0x3a08, 0x01}, {0x3a09, 0x27}, //AEC B50 step
-	{0x3a0a, 0x00}, {0x3a0b, 0xf6},
-	{0x4001, 0x02}, {0x4004, 0x02}, //BLC ctrl
-
-	{0x300e, 0x58}, //MIPI ctrl
-	{0x4300, 0x32}, //YUV422, YUYV
-	{0x501f, 0x00}, //ISP YUV422
-	{0x4713, 0x02}, //Jpeg mode 2
-	{0x4407, 0x04}, {0x440e, 0x00}, //JPG ctrl
-	{0x460b, 0x35}, //Debug
-	{0x460c, 0x22}, //DVP PCLK divider control by 0x3824
-	{0x471d, 0x00}, //[EVAL 01] VSYNC_mode according to FPGA
-	{0x4740, 0x21}, //[EVAL 20] VSYNC active high, HREF active low
-	{0x5000, 0xa7}, //ISP ctrl
-	{0x5180, 0xff}, {0x5181, 0xf2}, //AWB
-	{0x5182, 0x00}, {0x5183, 0x14},
-	{0x5184, 0x25}, {0x5185, 0x24},
-	{0x5186, 0x09}, {0x5187, 0x09},
-	{0x5188, 0x09}, {0x5189, 0x75},
-	{0x518a, 0x54}, {0x518b, 0xe0},
-	{0x518c, 0xb2}, {0x518d, 0x42},
-	{0x518e, 0x3d}, {0x518f, 0x56},
-	{0x5190, 0x46}, {0x5191, 0xf8},
-	{0x5192, 0x04}, {0x5193, 0x70},
-	{0x5194, 0xf0}, {0x5195, 0xf0},
-	{0x5196, 0x03}, {0x5197, 0x01},
-	{0x5198, 0x04}, {0x5199, 0x12},
-	{0x519a, 0x04}, {0x519b, 0x00},
-	{0x519c, 0x06}, {0x519d, 0x82},
-	{0x519e, 0x38},
-
-	{0x5381, 0x1e}, {0x5382, 0x5b}, //CMX
-	{0x5383, 0x08}, {0x5384, 0x0a},
-	{0x5385, 0x7e}, {0x5386, 0x88},
-	{0x5387, 0x7c}, {0x5388, 0x6c},
-	{0x5389, 0x10}, {0x538a, 0x01},
-	{0x538b, 0x98},
-
-	{0x5300, 0x08}, {0x5301, 0x30}, //CIP
-	{0x5302, 0x10}, {0x5303, 0x00},
-	{0x5304, 0x08}, {0x5305, 0x30},
-	{0x5306, 0x08}, {0x5307, 0x16},
-	{0x5309, 0x08}, {0x530a, 0x30},
-	{0x530b, 0x04}, {0x530c, 0x06},
-
-	{0x5480, 0x01}, {0x5481, 0x08}, //Gamma
-	{0x5482, 0x14}, {0x5483, 0x28},
-	{0x5484, 0x51}, {0x5485, 0x65},
-	{0x5486, 0x71}, {0x5487, 0x7d},
-	{0x5488, 0x87}, {0x5489, 0x91},
-	{0x548a, 0x9a}, {0x548b, 0xaa},
-	{0x548c, 0xb8}, {0x548d, 0xcd},
-	{0x548e, 0xdd}, {0x548f, 0xea},
-	{0x5490, 0x1d},
-
-	{0x5580, 0x02}, {0x5583, 0x40}, //SDE
-	{0x5584, 0x10}, {0x5589, 0x10},
-	{0x558a, 0x00}, {0x558b, 0xf8},
-
-	{0x5800, 0x3f}, {0x5801, 0x21}, //LENC
-	{0x5802, 0x13}, {0x5803, 0x11},
-	{0x5804, 0x1a}, {0x5805, 0x29},
-	{0x5806, 0x19}, {0x5807, 0x0c},
-	{0x5808, 0x06}, {0x5809, 0x04},
-	{0x580a, 0x08}, {0x580b, 0x18},
-	{0x580c, 0x12}, {0x580d, 0x06},
-	{0x580e, 0x01}, {0x580f, 0x00},
-	{0x5810, 0x04}, {0x5811, 0x0e},
-	{0x5812, 0x13}, {0x5813, 0x07},
-	{0x5814, 0x01}, {0x5815, 0x01},
-	{0x5816, 0x05}, {0x5817, 0x11},
-	{0x5818, 0x1e}, {0x5819, 0x10},
-	{0x581a, 0x0a}, {0x581b, 0x09},
-	{0x581c, 0x0f}, {0x581d, 0x1d},
-	{0x581e, 0x3f}, {0x581f, 0x2d},
-	{0x5820, 0x1e}, {0x5821, 0x1f},
-	{0x5822, 0x29}, {0x5823, 0x3f},
-	{0x5824, 0x16}, {0x5825, 0x18},
-	{0x5826, 0x09}, {0x5827, 0x17},
-	{0x5828, 0x1a}, {0x5829, 0x29},
-	{0x582a, 0x27}, {0x582b, 0x25},
-	{0x582c, 0x27}, {0x582d, 0x17},
-	{0x582e, 0x19}, {0x582f, 0x43},
-	{0x5830, 0x50}, {0x5831, 0x32},
-	{0x5832, 0x29}, {0x5833, 0x2b},
-	{0x5834, 0x38}, {0x5835, 0x36},
-	{0x5836, 0x27}, {0x5837, 0x28},
-	{0x5838, 0x28}, {0x5839, 0x2a},
-	{0x583a, 0x1e}, {0x583b, 0x2a},
-	{0x583c, 0x47}, {0x583d, 0xce},
-
-	{0x3a0f, 0x30}, {0x3a10, 0x28}, //AEC/AGC control start
-	{0x3a1b, 0x30}, {0x3a1e, 0x26},
-	{0x3a11, 0x60}, {0x3a1f, 0x14},
-
-	{0x5001, 0xa3}, //ISP ctrl, Scale enable
-	{0x3008, 0x02}, //Enable PCLK
+/* AF MCU commands, written to OV5640_AF_CMD_MAIN */
+#define OV5640_AF_TRIG_SINGLE           0x03
+#define OV5640_AF_CONTINUOUS            0x04
+#define OV5640_AF_PAUSE                 0x06
+#define OV5640_AF_RELEASE               0x08
+
+/* OV5640_AF_FW_STATUS values */
+#define OV5640_AF_STATUS_FOCUSING       0x00
+#define OV5640_AF_STATUS_FOCUSED        0x10
+#define OV5640_AF_STATUS_IDLE           0x70
+
+/* start the MCU on a downloaded firmware */
+static struct reg_value ov5640_af_launch[] = {
+	{ OV5640_AF_CMD_MAIN, 0x00 },
+	{ OV5640_AF_CMD_ACK, 0x00 },
+	{ 0x3024, 0x00 },
+	{ 0x3025, 0x00 },
+	{ 0x3026, 0x00 },
+	{ 0x3027, 0x00 },
+	{ 0x3028, 0x00 },
+	{ OV5640_AF_FW_STATUS, 0x7f },
+	{ OV5640_SYSTEM_RESET00, 0x00 },	/* MCU out of reset */
 };
 
+
 /* attribute sysfs files */
 static ssize_t enable_stream_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
+	struct vcam_data *data = dev_get_drvdata(dev);
 	unsigned long val;
+	int ret;
 
 	if (kstrtoul(buf, 0, &val) < 0)
 		return -EINVAL;
 
-	ov5640_enable_stream(dev, val);
+	if (down_interruptible(&data->sem))
+		return -ERESTARTSYS;
+	ret = ov5640_enable_stream(dev, val);
+	up(&data->sem);
+	if (ret)
+		return ret < 0 ? ret : -EIO;
 	return count;
 }
 
 static ssize_t flip_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
+	struct vcam_data *data = dev_get_drvdata(dev);
 	unsigned long val;
+	int ret;
 
 	if (kstrtoul(buf, 0, &val) < 0)
 		return -EINVAL;
 
-	ov5640_flipimage(dev, val);
+	if (down_interruptible(&data->sem))
+		return -ERESTARTSYS;
+	ret = ov5640_flipimage(dev, val);
+	up(&data->sem);
+	if (ret)
+		return ret < 0 ? ret : -EIO;
 	return count;
 }
 
 static ssize_t testpattern_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
+	struct vcam_data *data = dev_get_drvdata(dev);
 	unsigned long val;
+	int ret;
 
 	if (kstrtoul(buf, 0, &val) < 0)
 		return -EINVAL;
 
-	ov5640_testpattern_enable(dev, (unsigned char)val);
+	if (down_interruptible(&data->sem))
+		return -ERESTARTSYS;
+	ret = ov5640_testpattern_enable(dev, (unsigned char)val);
+	up(&data->sem);
+	if (ret)
+		return ret < 0 ? ret : -EIO;
 	return count;
 }
 
@@ -1065,40 +198,63 @@ static ssize_t testpattern_show(struct device *dev, struct device_attribute *att
 }
 static ssize_t mirror_enable_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
+	struct vcam_data *data = dev_get_drvdata(dev);
 	unsigned long val;
+	int ret;
 
 	if (kstrtoul(buf, 0, &val) < 0)
 		return -EINVAL;
 
-	ov5640_mirror_enable(dev, val);
+	if (down_interruptible(&data->sem))
+		return -ERESTARTSYS;
+	ret = ov5640_mirror_enable(dev, val);
+	up(&data->sem);
+	if (ret)
+		return ret < 0 ? ret : -EIO;
 	return count;
 }
 
 static ssize_t autofocus_enable_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
 	unsigned long val;
+	int ret;
 
 	if (kstrtoul(buf, 0, &val) < 0)
 		return -EINVAL;
 
-	ov5640_autofocus_enable(dev, val);
+	ret = ov5640_autofocus_enable(dev, val);
+	if (ret)
+		return ret < 0 ? ret : -EIO;
 	return count;
 }
 
 
 static ssize_t fov_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct ov5640_ae_state ae;
 	unsigned long val;
+	int ret;
 
 	if (kstrtoul(buf, 0, &val) < 0)
 		return -EINVAL;
-	ov5640_set_fov(dev, val);
+
+	/* same as IOCTL_CAM_SET_FOV, the capture and switch share state with the works */
+	if (down_interruptible(&data->sem))
+		return -ERESTARTSYS;
+	data->grab_pending = false;
+	ret = ov5640_set_fov(dev, val, ov5640_capture_ae(dev, &ae));
+	up(&data->sem);
+	if (ret)
+		return ret < 0 ? ret : -EIO;
 	return count;
 }
 
 static ssize_t fov_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
-	sprintf(buf, "VCAM OV5640 FOV: (54 39 28) %i\n", g_vcamFOV);
+	struct vcam_data *data = dev_get_drvdata(dev);
+
+	sprintf(buf, "VCAM OV5640 FOV: (54 39 28) %i\n", data->fov);
 	return strlen(buf);
 }
 
@@ -1141,6 +297,99 @@ void ov5640_remove_sysfs_attributes(struct device *dev)
 /* end sysfs attributes */
 
 
+/* ov5640_i2c_recover
+ *
+ * Run the adapter bus recovery for errors that indicate a stuck bus
+ *
+ * Returns 0 if the bus was recovered
+ *         negative on error
+ */
+static int ov5640_i2c_recover(struct device *dev, int err)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct i2c_adapter *adap = data->i2c_bus;
+	int ret;
+
+	if (err != -ETIMEDOUT && err != -EBUSY && err != -EAGAIN)
+		return err;
+
+	if (!adap->bus_recovery_info)
+		return -EOPNOTSUPP;
+
+	dev_warn(dev, "I2C bus stuck (%i), running bus recovery\n", err);
+	i2c_lock_bus(adap, I2C_LOCK_ROOT_ADAPTER);
+	ret = i2c_recover_bus(adap);
+	i2c_unlock_bus(adap, I2C_LOCK_ROOT_ADAPTER);
+	if (ret)
+		dev_err(dev, "I2C bus recovery failed (%i)\n", ret);
+
+	return ret;
+}
+
+/* ov5640_i2c_transfer
+ *
+ * i2c_transfer() with retries. A failed transfer is retried with
+ * exponential backoff from OV5640_I2C_BACKOFF_MIN_US until
+ * OV5640_I2C_DEADLINE_US has passed. If the bus is stuck, the adapter bus
+ * recovery is run once and the transfer gets a new deadline. A NACK means
+ * the sensor is not answering and fails at once.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_i2c_transfer(struct device *dev, struct i2c_msg *msgs, int num)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	bool recovered = false;
+	unsigned int backoff;
+	ktime_t deadline;
+	int ret;
+
+retry:
+	backoff = OV5640_I2C_BACKOFF_MIN_US;
+	deadline = ktime_add_us(ktime_get(), OV5640_I2C_DEADLINE_US);
+
+	for (;;) {
+		ret = i2c_transfer(data->i2c_bus, msgs, num);
+		if (ret == num)
+			return 0;
+		if (ret >= 0)
+			ret = -EIO;
+		if (ret == -ENXIO || ret == -EREMOTEIO)
+			return ret;
+
+		if (ktime_after(ktime_get(), deadline))
+			break;
+
+		usleep_range(backoff, 2 * backoff);
+		backoff = min_t(unsigned int, 2 * backoff, OV5640_I2C_BACKOFF_MAX_US);
+	}
+
+	if (!recovered && ov5640_i2c_recover(dev, ret) == 0) {
+		recovered = true;
+		goto retry;
+	}
+
+	return ret;
+}
+
+/* ov5640_shadow_update
+ *
+ * Remember values written to the sensor, for the debugfs shadow dump
+ */
+static void ov5640_shadow_update(struct vcam_data *data, u16 reg, const u8 *val, size_t len)
+{
+	size_t i;
+
+	if (!data->reg_shadow)
+		return;
+
+	for (i = 0; i < len && reg + i < OV5640_REG_SPACE; i++) {
+		data->reg_shadow[reg + i] = val[i];
+		set_bit(reg + i, data->reg_written);
+	}
+}
+
 /* ov5640_write_reg
  *
  * Returns 0 on success
@@ -1162,9 +411,10 @@ static int ov5640_write_reg(struct device *dev, u16 reg, u8 val)
 	msgs[0].buf = buf;
 	msgs[0].len = 3;
 
-	ret = i2c_transfer(data->i2c_bus, msgs, 1);
-	if (ret <= 0)
+	ret = ov5640_i2c_transfer(dev, msgs, 1);
+	if (ret < 0)
 		return ret;
+	ov5640_shadow_update(data, reg, &val, 1);
 	return 0;
 }
 
@@ -1189,8 +439,8 @@ static int ov5640_read_reg(struct device *dev, u16 reg, u8 *val)
 	buf[0] = reg >> 8;
 	buf[1] = reg & 0xff;
 
-	ret = i2c_transfer(data->i2c_bus, msgs, 1);
-	if (ret <= 0)
+	ret = ov5640_i2c_transfer(dev, msgs, 1);
+	if (ret < 0)
 		return ret;
 
 	/* Send in master receive mode. */
@@ -1198,14 +448,95 @@ static int ov5640_read_reg(struct device *dev, u16 reg, u8 *val)
 	msgs[0].len = 1;
 	msgs[0].buf = val;
 
-	ret = i2c_transfer(data->i2c_bus, msgs, 1);
-	if (ret <= 0)
-		return ret;
+	return ov5640_i2c_transfer(dev, msgs, 1);
+}
+
+/* ov5640_read_regs
+ *
+ * Read len consecutive registers starting at reg, using the sensor
+ * address auto increment to read up to OV5640_BURST_LEN bytes per transfer.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+int ov5640_read_regs(struct device *dev, u16 reg, u8 *val, size_t len)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct i2c_msg msgs[2];
+	u8 addr[2];
+	size_t n;
+	int ret;
+
+	while (len) {
+		n = min_t(size_t, len, OV5640_BURST_LEN);
+
+		addr[0] = reg >> 8;
+		addr[1] = reg & 0xff;
+
+		msgs[0].addr = data->i2c_address >> 1;
+		msgs[0].flags = 0;
+		msgs[0].len = 2;
+		msgs[0].buf = addr;
+
+		msgs[1].addr = data->i2c_address >> 1;
+		msgs[1].flags = I2C_M_RD;
+		msgs[1].len = n;
+		msgs[1].buf = val;
+
+		ret = ov5640_i2c_transfer(dev, msgs, 2);
+		if (ret < 0)
+			return ret;
+
+		reg += n;
+		val += n;
+		len -= n;
+	}
 
 	return 0;
 }
 
-/* ov5640_read_reg
+/* ov5640_write_regs
+ *
+ * Burst write len consecutive registers starting at reg, up to
+ * OV5640_BURST_LEN bytes per transfer.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+int ov5640_write_regs(struct device *dev, u16 reg, const u8 *val, size_t len)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct i2c_msg msg;
+	u8 buf[2 + OV5640_BURST_LEN];
+	size_t n;
+	int ret;
+
+	while (len) {
+		n = min_t(size_t, len, OV5640_BURST_LEN);
+
+		buf[0] = reg >> 8;
+		buf[1] = reg & 0xff;
+		memcpy(&buf[2], val, n);
+
+		msg.addr = data->i2c_address >> 1;
+		msg.flags = 0;
+		msg.len = n + 2;
+		msg.buf = buf;
+
+		ret = ov5640_i2c_transfer(dev, &msg, 1);
+		if (ret < 0)
+			return ret;
+
+		ov5640_shadow_update(data, reg, val, n);
+		reg += n;
+		val += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* ov5640_mod_reg
  *
  * Returns 0 on success
  *         negative on error
@@ -1364,9 +695,9 @@ static int ov5640_set_sensor_model_conf(struct device *dev)
 
 	if (data->sensor_model == OV5640_HIGH_K) {
 		dev_info(dev, "Selecting High_K config\n");
-		ret = ov5640_doi2cwrite(dev, ov5640_setting_High_K, OV5640_SETTING_HIGH_K_ELEMENTS);
+		ret = ov5640_run_program(dev, ov5640_setting_High_K);
 		if (ret) {
-			dev_err(dev, "ov5640_doi2cwrite() failed for camera\n");
+			dev_err(dev, "ov5640_run_program() failed for camera\n");
 		}
 	} else if (data->sensor_model == OV5640_STANDARD) {
 		dev_info(dev, "Selecting Standard OV5640 config\n");
@@ -1378,7 +709,87 @@ static int ov5640_set_sensor_model_conf(struct device *dev)
 	return ret;
 }
 
-/* ov5640_set_sensor_model_conf
+/* ov5640_poll_reg
+ *
+ * Wait until (reg & mask) == val
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_poll_reg(struct device *dev, u16 reg, u8 mask, u8 val, unsigned int timeout_ms)
+{
+	ktime_t timeout = ktime_add_ms(ktime_get(), timeout_ms);
+	u8 cur;
+	int ret;
+
+	for (;;) {
+		ret = ov5640_read_reg(dev, reg, &cur);
+		if (ret < 0)
+			return ret;
+		if ((cur & mask) == val)
+			return 0;
+		if (ktime_after(ktime_get(), timeout))
+			return -ETIMEDOUT;
+		usleep_range(100, 200);
+	}
+}
+
+/* ov5640_run_program
+ *
+ * Execute a register program generated by ov5640_regc, see ov5640_regc.h
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+int ov5640_run_program(struct device *dev, const u8 *prog)
+{
+	const u8 *pc = prog;
+	u16 reg, arg;
+	int ret;
+
+	for (;;) {
+		switch (*pc++) {
+		case OV5640_OP_END:
+			return 0;
+
+		case OV5640_OP_WRITE:
+			reg = (pc[0] << 8) | pc[1];
+			ret = ov5640_write_regs(dev, reg, &pc[3], pc[2]);
+			if (ret) {
+				dev_err(dev, "program write of %u registers at 0x%04x failed (%i)\n",
+					pc[2], reg, ret);
+				return ret;
+			}
+			pc += 3 + pc[2];
+			break;
+
+		case OV5640_OP_DELAY:
+			arg = (pc[0] << 8) | pc[1];
+			fsleep(arg);
+			pc += 2;
+			break;
+
+		case OV5640_OP_POLL:
+			reg = (pc[0] << 8) | pc[1];
+			arg = (pc[4] << 8) | pc[5];
+			ret = ov5640_poll_reg(dev, reg, pc[2], pc[3], arg);
+			if (ret) {
+				dev_err(dev, "program poll of 0x%04x failed (%i)\n", reg, ret);
+				return ret;
+			}
+			pc += 6;
+			break;
+
+		default:
+			dev_err(dev, "invalid program opcode 0x%02x at %td\n", pc[-1], pc - 1 - prog);
+			return -EINVAL;
+		}
+	}
+}
+
+/* ov5640_doi2cwrite
+ *
+ * Write a register table, one entry per transfer
  *
  * Returns 0 on success
  *         negative on error
@@ -1407,152 +818,991 @@ int ov5640_doi2cwrite(struct device *dev, struct reg_value *pMode, USHORT elemen
 		buf[1] = RegAddr & 0xff;
 		buf[2] = Val;
 
-		retval = i2c_transfer(data->i2c_bus, msgs, 1);
-
-		if (retval == -EAGAIN) {
-			msleep(100);
-			retval = i2c_transfer(data->i2c_bus, msgs, 1);
-		}
-
-		if (retval <= 0) {
+		/* retries stay on the failing entry, the table is never restarted */
+		retval = ov5640_i2c_transfer(dev, msgs, 1);
+		if (retval < 0) {
 			dev_err(dev, "failed on index i=%i with error %i (data 0x%x:0x%x)\n",
 				i, retval, RegAddr, Val);
 			return retval;
 		}
+		ov5640_shadow_update(data, RegAddr, &Val, 1);
 	}
 
 	return 0;
 }
 
-/* OV640_enable_stream
+/* ov5640_wait_ready
+ *
+ * Poll the chip id after power up until the sensor answers, instead of
+ * sleeping the worst case SCCB startup time. Each read is retried with
+ * backoff by ov5640_i2c_transfer().
  *
+ * Returns 0 on success
+ *         negative on error
  */
-void ov5640_enable_stream(struct device *dev, bool enable)
+int ov5640_wait_ready(struct device *dev)
 {
-	if (enable)
-		ov5640_doi2cwrite(dev, &stream_on, 1);
-	else
-		ov5640_doi2cwrite(dev, &stream_off, 1);
+	ktime_t timeout = ktime_add_us(ktime_get(), OV5640_READY_TIMEOUT_US);
+	u8 id[2];
+	int ret;
+
+	do {
+		ret = ov5640_read_regs(dev, OV5640_CHIP_ID_HIGH_BYTE, id, sizeof(id));
+		if (ret == 0) {
+			if (id[0] == 0x56 && id[1] == 0x40)
+				return 0;
+			ret = -ENODEV;
+		}
+	} while (ktime_before(ktime_get(), timeout));
+
+	return ret;
 }
 
-/* ov5640_nightmode_enable
+/* OV640_enable_stream
  *
+ * Returns 0 on success
+ *         negative on error
  */
-static void ov5640_nightmode_enable(struct device *dev, bool enable)
+int ov5640_enable_stream(struct device *dev, bool enable)
 {
-
 	if (enable)
-		ov5640_doi2cwrite(dev, &night_mode_on, 1);
+		return ov5640_doi2cwrite(dev, &stream_on, 1);
 	else
-		ov5640_doi2cwrite(dev, &night_mode_off, 1);
+		return ov5640_doi2cwrite(dev, &stream_off, 1);
 }
 
-/* ov5640_nightmode_enable
- * returns int on error
- *
- * Return value is an integer error value
- * that is 0 on success, and negative on error, this is casted? to a int, should end up as
- * 0 on success and positive value on error...
+/* ov5640_set_strobe
  *
+ * Request or release the sensor STROBE output. The strobe runs in LED3
+ * mode, where the sensor times the pulse to the exposure of the next frame.
  *
+ * Returns 0 on success
+ *         negative on error
  */
-static int ov5640_mirror_enable(struct device *dev, bool enable)
+int ov5640_set_strobe(struct device *dev, bool enable)
 {
 	int ret;
 
-	if (enable)
-		ret = ov5640_doi2cwrite(dev, &ov5640_mirror_on_reg, 1);
-	else
-		ret = ov5640_doi2cwrite(dev, &ov5640_mirror_off_reg, 1);
-	return ret;
+	if (enable) {
+		ret = ov5640_mod_reg(dev, OV5640_PAD_OUTPUT_ENABLE00, BIT(1), BIT(1));
+		if (ret < 0)
+			return ret;
+		return ov5640_write_reg(dev, OV5640_STROBE_CTRL, 0x83);
+	}
+
+	return ov5640_write_reg(dev, OV5640_STROBE_CTRL, 0x03);
 }
 
-/* ov5640_autofocus_enable
+/* ov5640_find_timing
  *
+ * Nominal timing of a draft fov, or of the 5MP still mode for fov 0
  */
-static void ov5640_autofocus_enable(struct device *dev, bool enable)
+static const struct ov5640_mode_timing *ov5640_find_timing(struct vcam_data *data, int fov)
 {
-	if (enable)
-		ov5640_doi2cwrite(dev, &autofocus_on, 1);
-	else
-		ov5640_doi2cwrite(dev, &autofocus_off, 1);
+	int iface = data->profile.parallel_interface ? OV5640_IF_DVP : OV5640_IF_MIPI;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ov5640_mode_timings); i++)
+		if (ov5640_mode_timings[i].fov == fov &&
+		    (ov5640_mode_timings[i].iface == OV5640_IF_ANY ||
+		     ov5640_mode_timings[i].iface == iface) &&
+		    (fov || ov5640_mode_timings[i].fps == data->still_fps))
+			return &ov5640_mode_timings[i];
+
+	return &ov5640_mode_timings[0];
 }
 
-/* ov5640_set_exposure
- * Set vcam exposure value
+/* ov5640_select_still_fps
  *
+ * 15 fps 5MP needs OV5640_5MP_15FPS_LANE_MBPS from the MIPI receiver,
+ * boards that do not declare it in vcam_mipi_max_mbps stay at 9 fps
+ * unless forced by the still_fps parameter. The parallel 5MP program has
+ * a single rate.
  */
-static void ov5640_set_exposure(struct device *dev, int exp)
+static unsigned int ov5640_select_still_fps(struct device *dev)
 {
-	struct reg_value temp;
+	struct vcam_data *data = dev_get_drvdata(dev);
+
+	if (data->profile.parallel_interface)
+		return OV5640_DVP_5MP_FPS;
+	if (still_fps == 15 || still_fps == 9)
+		return still_fps;
+	if (data->profile.mipi_max_mbps >= OV5640_5MP_15FPS_LANE_MBPS)
+		return 15;
+	return 9;
+}
 
-	temp.u16RegAddr = 0x3500;
-	temp.u8Val = ((exp >> 16) & 0x0f);
-	ov5640_doi2cwrite(dev, &temp, 1);
+/* ov5640_current_timing
+ *
+ * Nominal timing of the mode the sensor is in
+ */
+static const struct ov5640_mode_timing *ov5640_current_timing(struct vcam_data *data)
+{
+	return ov5640_find_timing(data, (data->cam_mode == VCAM_STILL) ? 0 : data->fov);
+}
 
-	temp.u16RegAddr = 0x3501;
-	temp.u8Val = ((exp >> 8) & 0xff);
-	ov5640_doi2cwrite(dev, &temp, 1);
+/* ov5640_frame_period_us
+ *
+ * Nominal frame period of the current mode
+ */
+unsigned int ov5640_frame_period_us(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
 
-	temp.u16RegAddr = 0x3502;
-	temp.u8Val = (exp & 0xf0);
-	ov5640_doi2cwrite(dev, &temp, 1);
+	return 1000000 / ov5640_current_timing(data)->fps;
 }
 
-/* ov5640_nightmode_on_off_work
+/* ov5640_mode_fps
  *
- * workqueue work thingy...
+ * Nominal frame rate of a draft fov, or of the 5MP still mode for fov 0
  */
-static void ov5640_nightmode_on_off_work(struct work_struct *work)
+unsigned int ov5640_mode_fps(struct device *dev, int fov)
 {
-	struct vcam_data *data = container_of(work, struct vcam_data, nightmode_work);
-	struct device *dev = data->dev;
+	struct vcam_data *data = dev_get_drvdata(dev);
 
-	if(! disable_nightmode) {
-	msleep(1000);
-	ov5640_nightmode_enable(dev, FALSE);
-	msleep(1000);
-	ov5640_nightmode_enable(dev, TRUE);
-	}
+	return ov5640_find_timing(data, fov)->fps;
 }
 
+/* ov5640_nightmode_enable
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_nightmode_enable(struct device *dev, bool enable)
+{
+	if (enable)
+		return ov5640_doi2cwrite(dev, &night_mode_on, 1);
+	else
+		return ov5640_doi2cwrite(dev, &night_mode_off, 1);
+}
 
-/* ov5640_set_5mp
+/* ov5640_nightmode_enable
+ * returns int on error
  *
- * returns 0 on success
- *         <0, (or >0) on  error...
+ * Return value is an integer error value
+ * that is 0 on success, and negative on error, this is casted? to a int, should end up as
+ * 0 on success and positive value on error...
  *
- * sets modes ov5640_init_settings_9fps_5MP
- *            ov5640_edge_enhancement
- *            ov5640_flipimage      - default flip of sensor??
- *            ov5640_mirror_enable  - default mirror of sensor??
- *                image flip and mirror enable, might also be set in ov5640_init_settings_9fps_5MP and similar structs...
  *
  */
-static int ov5640_set_5mp(struct device *dev)
+static int ov5640_mirror_enable(struct device *dev, bool enable)
 {
 	struct vcam_data *data = dev_get_drvdata(dev);
 	int ret;
 
-	bool ov5640_using_mipi_interface = !of_find_property(dev->of_node, VCAM_PARALLELL_INTERFACE, NULL);
-
-	ov5640_enable_stream(dev, FALSE);
-
-	/* Initialize camera settings */
-	if (ov5640_using_mipi_interface)
-		ret = ov5640_doi2cwrite(dev, ov5640_init_setting_9fps_5MP, OV5640_INIT_SETTING_9FPS_5MP_ELEMENTS);
+	if (enable)
+		ret = ov5640_doi2cwrite(dev, &ov5640_mirror_on_reg, 1);
 	else
-		ret = ov5640_doi2cwrite(dev, ov5640_init_setting_5MP, OV5640_INIT_SETTING_5MP_ELEMENTS);
+		ret = ov5640_doi2cwrite(dev, &ov5640_mirror_off_reg, 1);
 
-	if (ret) {
-		dev_err(dev, "Failed to set %s 5MP mode\n", ov5640_using_mipi_interface ? "MIPI" : "parallell");
-		return ret;
+	if (ret == 0) {
+		data->mirror = enable;
+		vcam_status_publish(data);
 	}
+	return ret;
+}
 
-	/* Write model specific configuration */
-	ov5640_set_sensor_model_conf(dev);
-
-	if (data->edge_enhancement) {
+/* ov5640_af_load
+ *
+ * Download the AF MCU firmware to 0x8000 in OV5640_BURST_LEN bursts and
+ * start it. A byte per transfer would take hundreds of milliseconds.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_af_load(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	const struct firmware *fw;
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = request_firmware(&fw, af_firmware, dev);
+	if (ret) {
+		dev_err(dev, "Failed to load AF firmware %s (%i)\n", af_firmware, ret);
+		return ret;
+	}
+
+	if (!fw->size || fw->size > OV5640_AF_FW_MAX_SIZE) {
+		dev_err(dev, "AF firmware %s has invalid size %zu\n", af_firmware, fw->size);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* hold the MCU in reset while its memory is written */
+	ret = ov5640_write_reg(dev, OV5640_SYSTEM_RESET00, 0x20);
+	if (ret == 0)
+		ret = ov5640_write_regs(dev, OV5640_AF_FW_BASE, fw->data, fw->size);
+	if (ret == 0)
+		ret = ov5640_doi2cwrite(dev, ov5640_af_launch, ARRAY_SIZE(ov5640_af_launch));
+	if (ret == 0)
+		ret = ov5640_poll_reg(dev, OV5640_AF_FW_STATUS, 0xff, OV5640_AF_STATUS_IDLE,
+				      OV5640_AF_READY_TIMEOUT_MS);
+	if (ret) {
+		dev_err(dev, "Failed to start AF firmware (%i)\n", ret);
+		goto out;
+	}
+
+	data->af_loaded = true;
+	dev_info(dev, "AF firmware loaded, %zu bytes in %lld us\n", fw->size,
+		 ktime_us_delta(ktime_get(), start));
+out:
+	release_firmware(fw);
+	return ret;
+}
+
+/* ov5640_af_ready
+ *
+ * Make sure the AF firmware runs. It is downloaded once per power cycle
+ * and kept while the sensor is powered; it is only downloaded again if
+ * the MCU no longer reports a running state.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_af_ready(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	u8 status;
+
+	if (data->af_loaded && ov5640_read_reg(dev, OV5640_AF_FW_STATUS, &status) >= 0) {
+		switch (status) {
+		case OV5640_AF_STATUS_FOCUSING:
+		case OV5640_AF_STATUS_FOCUSED:
+		case OV5640_AF_STATUS_IDLE:
+			return 0;
+		}
+	}
+
+	data->af_loaded = false;
+	data->af_continuous = false;
+	return ov5640_af_load(dev);
+}
+
+/* ov5640_af_command
+ *
+ * Issue an AF MCU command and wait for the firmware to acknowledge it.
+ * Focusing itself continues in the background.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_af_command(struct device *dev, u8 cmd)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	int ret;
+
+	ret = ov5640_af_ready(dev);
+	if (ret)
+		return ret;
+
+	ret = ov5640_write_reg(dev, OV5640_AF_CMD_ACK, 0x01);
+	if (ret == 0)
+		ret = ov5640_write_reg(dev, OV5640_AF_CMD_MAIN, cmd);
+	if (ret == 0)
+		ret = ov5640_poll_reg(dev, OV5640_AF_CMD_ACK, 0xff, 0x00, OV5640_AF_ACK_TIMEOUT_MS);
+	if (ret) {
+		dev_err(dev, "AF command 0x%02x failed (%i)\n", cmd, ret);
+		return ret;
+	}
+
+	data->af_continuous = (cmd == OV5640_AF_CONTINUOUS);
+	return 0;
+}
+
+/* ov5640_manual_focus
+ *
+ * Take the lens from the AF firmware, if loaded, and return the slew
+ * control bits to keep in OV5640_VCM_CTRL0. Called with data->sem held.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_manual_focus(struct device *dev, u8 *slew)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	int ret;
+
+	if (data->af_loaded) {
+		ret = ov5640_af_command(dev, OV5640_AF_PAUSE);
+		if (ret)
+			return ret;
+	}
+
+	ret = ov5640_read_reg(dev, OV5640_VCM_CTRL0, slew);
+	if (ret < 0)
+		return ret;
+	*slew &= 0x0f;
+	return 0;
+}
+
+/* ov5640_write_lens
+ *
+ * Move the lens, both VCM DAC registers in one transfer
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_write_lens(struct device *dev, int pos, u8 slew)
+{
+	u8 vcm[2] = { ((pos & 0x0f) << 4) | slew, (pos >> 4) & 0x3f };
+
+	return ov5640_write_regs(dev, OV5640_VCM_CTRL0, vcm, sizeof(vcm));
+}
+
+/* ov5640_frame_count
+ *
+ * Frames started since probe, 0 without VSYNC interrupt
+ */
+static u64 ov5640_frame_count(struct vcam_data *data)
+{
+	u64 count;
+
+	spin_lock_irq(&data->frames.lock);
+	count = data->frames.count;
+	spin_unlock_irq(&data->frames.lock);
+	return count;
+}
+
+/* ov5640_focus_sweep
+ *
+ * Step the lens through the requested positions, one per frame. Each
+ * position is written right after a VSYNC edge and data->sem is released
+ * while waiting for the next one.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_focus_sweep(struct device *dev, VCAMIOCTLFOCUSSWEEP *sweep)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	unsigned int period_us;
+	unsigned int i;
+	u64 seen = 0;
+	u8 slew = 0;
+	long left;
+	int ret;
+
+	if (sweep->count < 1 || sweep->count > VCAM_FOCUS_SWEEP_MAX)
+		return -EINVAL;
+	for (i = 0; i < sweep->count; i++)
+		if (sweep->lensPos[i] < 0 || sweep->lensPos[i] > VCAM_FOCUS_MAX)
+			return -EINVAL;
+
+	for (i = 0; i < sweep->count; i++) {
+		if (down_interruptible(&data->sem))
+			return -ERESTARTSYS;
+		ret = i ? 0 : ov5640_manual_focus(dev, &slew);
+		if (ret == 0)
+			ret = ov5640_write_lens(dev, sweep->lensPos[i], slew);
+		seen = ov5640_frame_count(data);
+		period_us = ov5640_frame_period_us(dev);
+		up(&data->sem);
+		if (ret)
+			return ret;
+
+		sweep->frame[i] = data->frames.irq ? seen + 1 : 0;
+		if (i + 1 == sweep->count)
+			break;
+
+		if (!data->frames.irq) {
+			usleep_range(period_us, period_us + period_us / 8);
+			continue;
+		}
+
+		/* a missing edge means the sensor is not streaming */
+		left = wait_event_interruptible_timeout(data->frames.wait,
+							ov5640_frame_count(data) != seen,
+							usecs_to_jiffies(4 * period_us));
+		if (left < 0)
+			return -ERESTARTSYS;
+		if (left == 0)
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+/* ov5640_set_focus
+ *
+ * Continuous AF, a single AF run or a manual lens position.
+ * Called with data->sem held.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_set_focus(struct device *dev, const VCAMIOCTLFOCUS *focus)
+{
+	u8 slew;
+	int ret;
+
+	if (focus->bAutoFocus)
+		return ov5640_af_command(dev, OV5640_AF_CONTINUOUS);
+
+	if (focus->lensPos == VCAM_FOCUS_SINGLE)
+		return ov5640_af_command(dev, OV5640_AF_TRIG_SINGLE);
+
+	if (focus->lensPos < 0 || focus->lensPos > VCAM_FOCUS_MAX)
+		return -EINVAL;
+
+	ret = ov5640_manual_focus(dev, &slew);
+	if (ret)
+		return ret;
+	return ov5640_write_lens(dev, focus->lensPos, slew);
+}
+
+/* ov5640_get_focus
+ *
+ * Report the AF mode, the lens position and the focus state from 0x3029.
+ * Called with data->sem held.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_get_focus(struct device *dev, VCAMIOCTLFOCUS *focus)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	u8 vcm[2];
+	u8 status;
+	int ret;
+
+	focus->bAutoFocus = data->af_continuous;
+	focus->eState = VCAM_FOCUS_IDLE;
+
+	ret = ov5640_read_regs(dev, OV5640_VCM_CTRL0, vcm, sizeof(vcm));
+	if (ret)
+		return ret;
+	focus->lensPos = ((vcm[1] & 0x3f) << 4) | (vcm[0] >> 4);
+
+	if (!data->af_loaded)
+		return 0;
+
+	ret = ov5640_read_reg(dev, OV5640_AF_FW_STATUS, &status);
+	if (ret < 0)
+		return ret;
+
+	if (status == OV5640_AF_STATUS_FOCUSING)
+		focus->eState = VCAM_FOCUS_BUSY;
+	else if (status == OV5640_AF_STATUS_FOCUSED)
+		focus->eState = VCAM_FOCUS_DONE;
+	return 0;
+}
+
+/* ov5640_autofocus_enable
+ *
+ * Continuous AF, or pause with the lens kept where it is
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_autofocus_enable(struct device *dev, bool enable)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	int ret;
+
+	if (down_interruptible(&data->sem))
+		return -ERESTARTSYS;
+	ret = ov5640_af_command(dev, enable ? OV5640_AF_CONTINUOUS : OV5640_AF_PAUSE);
+	up(&data->sem);
+	return ret;
+}
+
+/* ov5640_get_ae_state
+ * Read current exposure, gain and AWB gains
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_get_ae_state(struct device *dev, struct ov5640_ae_state *ae)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	u8 regs[6];
+	int i, ret;
+
+	ae->timing = ov5640_current_timing(data);
+
+	for (i = 0; i < 3; i++) {
+		ret = ov5640_read_reg(dev, 0x3500 + i, &regs[i]);
+		if (ret < 0)
+			return ret;
+	}
+	ae->exposure = ((regs[0] & 0x0f) << 16) | (regs[1] << 8) | regs[2];
+
+	for (i = 0; i < 2; i++) {
+		ret = ov5640_read_reg(dev, 0x350a + i, &regs[i]);
+		if (ret < 0)
+			return ret;
+	}
+	ae->gain = ((regs[0] & 0x03) << 8) | regs[1];
+
+	for (i = 0; i < 6; i++) {
+		ret = ov5640_read_reg(dev, 0x3400 + i, &regs[i]);
+		if (ret < 0)
+			return ret;
+	}
+	for (i = 0; i < 3; i++)
+		ae->awb_gain[i] = ((regs[2 * i] & 0x0f) << 8) | regs[2 * i + 1];
+
+	return 0;
+}
+
+/* ov5640_scale_ae_state
+ * Convert exposure to a mode with a different line time and binning.
+ * Exposure that does not fit in the new frame is moved over to gain.
+ */
+static void ov5640_scale_ae_state(struct ov5640_ae_state *ae,
+				  const struct ov5640_mode_timing *to)
+{
+	const struct ov5640_mode_timing *from = ae->timing;
+	/* line time is 1 / (fps * vts), exposure scales with its inverse.
+	 * Summed pixels collect light bin times faster.
+	 */
+	u64 exposure = div_u64((u64)ae->exposure * to->fps * to->vts * from->bin,
+			       from->fps * from->vts * to->bin);
+	u32 max_exposure = (to->vts - 4) << 4;
+	u32 gain = ae->gain;
+
+	if (exposure > max_exposure) {
+		gain = div_u64((u64)gain * exposure, max_exposure);
+		exposure = max_exposure;
+	}
+
+	ae->timing = to;
+	ae->exposure = exposure;
+	ae->gain = min_t(u32, gain, 0x3ff);
+}
+
+/* ov5640_capture_ae
+ * Read the AEC/AWB state of the running mode before a mode switch
+ *
+ * Returns ae, or NULL if there is nothing to carry over
+ */
+static const struct ov5640_ae_state *ov5640_capture_ae(struct device *dev, struct ov5640_ae_state *ae)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+
+	if (data->cam_mode != VCAM_DRAFT && data->cam_mode != VCAM_STILL)
+		return NULL;
+	if (ov5640_get_ae_state(dev, ae))
+		return NULL;
+	return ae;
+}
+
+/* ov5640_write_ae_state
+ * Write exposure, gain and AWB gains with AEC/AGC and AWB in manual mode
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_write_ae_state(struct device *dev, const struct ov5640_ae_state *ae)
+{
+	struct reg_value regs[] = {
+		{ 0x3503, 0x03 },	/* manual AEC/AGC */
+		{ 0x3406, 0x01 },	/* manual AWB */
+		{ 0x3500, (ae->exposure >> 16) & 0x0f },
+		{ 0x3501, (ae->exposure >> 8) & 0xff },
+		{ 0x3502, ae->exposure & 0xf0 },
+		{ 0x350a, (ae->gain >> 8) & 0x03 },
+		{ 0x350b, ae->gain & 0xff },
+		{ 0x3400, (ae->awb_gain[0] >> 8) & 0x0f },
+		{ 0x3401, ae->awb_gain[0] & 0xff },
+		{ 0x3402, (ae->awb_gain[1] >> 8) & 0x0f },
+		{ 0x3403, ae->awb_gain[1] & 0xff },
+		{ 0x3404, (ae->awb_gain[2] >> 8) & 0x0f },
+		{ 0x3405, ae->awb_gain[2] & 0xff },
+	};
+
+	return ov5640_doi2cwrite(dev, regs, ARRAY_SIZE(regs));
+}
+
+/* ov5640_set_ae_state
+ * Write a carried AEC/AWB state, rescaled to the mode timing "to". AEC/AGC
+ * and AWB are left in manual mode, call ov5640_hold_ae() once streaming to
+ * hand them back to automatic control.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_set_ae_state(struct device *dev, const struct ov5640_ae_state *carried,
+			       const struct ov5640_mode_timing *to)
+{
+	struct ov5640_ae_state ae = *carried;
+
+	ov5640_scale_ae_state(&ae, to);
+	return ov5640_write_ae_state(dev, &ae);
+}
+
+/* ov5640_hold_ae
+ * Keep the carried AEC/AWB values for ae_hold_frames frames of the new
+ * mode, then ov5640_ae_release_work() hands back to automatic control.
+ */
+static void ov5640_hold_ae(struct device *dev, unsigned int frames)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+
+	data->ae_held = true;
+	vcam_mod_work(data, &data->ae_release_work,
+		      usecs_to_jiffies(frames * ov5640_frame_period_us(dev)));
+}
+
+/* ov5640_ae_release_work
+ *
+ * Return AEC/AGC and AWB to automatic after a held mode switch
+ */
+static void ov5640_ae_release_work(struct kthread_work *work)
+{
+	struct vcam_data *data = container_of(to_vcam_work(work), struct vcam_data, ae_release_work);
+	struct reg_value regs[] = {
+		{ 0x3503, 0x00 },	/* auto AEC/AGC */
+		{ 0x3406, 0x00 },	/* auto AWB */
+	};
+
+	vcam_work_start(data, to_vcam_work(work));
+
+	down(&data->sem);
+	if (data->ae_held && ov5640_doi2cwrite(data->dev, regs, ARRAY_SIZE(regs)) == 0)
+		data->ae_held = false;
+	up(&data->sem);
+}
+
+/* ov5640_read_stats
+ * Read exposure, gain, AWB gains, average luminance and AEC/AWB state in
+ * a single bus transaction. frame is filled in by the caller.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+int ov5640_read_stats(struct device *dev, VCAMIOCTLSTATS *stats)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	u8 awb[7], aec[4], gain[2], aec_ctrl, stable[2], luma;
+	struct {
+		u16 reg;
+		u8 *buf;
+		u16 len;
+	} ranges[] = {
+		{ 0x3400, awb, sizeof(awb) },		/* AWB gains, 0x3406 manual */
+		{ 0x3500, aec, sizeof(aec) },		/* exposure, 0x3503 manual */
+		{ 0x350a, gain, sizeof(gain) },
+		{ OV5640_AEC_CTRL00, &aec_ctrl, 1 },
+		{ OV5640_AEC_STABLE_HIGH, stable, sizeof(stable) },
+		{ OV5640_AVG_READOUT, &luma, 1 },
+	};
+	struct i2c_msg msgs[2 * ARRAY_SIZE(ranges)];
+	u8 addr[ARRAY_SIZE(ranges)][2];
+	int i, ret;
+
+	for (i = 0; i < ARRAY_SIZE(ranges); i++) {
+		addr[i][0] = ranges[i].reg >> 8;
+		addr[i][1] = ranges[i].reg & 0xff;
+
+		msgs[2 * i].addr = data->i2c_address >> 1;
+		msgs[2 * i].flags = 0;
+		msgs[2 * i].len = 2;
+		msgs[2 * i].buf = addr[i];
+
+		msgs[2 * i + 1].addr = data->i2c_address >> 1;
+		msgs[2 * i + 1].flags = I2C_M_RD;
+		msgs[2 * i + 1].len = ranges[i].len;
+		msgs[2 * i + 1].buf = ranges[i].buf;
+	}
+
+	ret = ov5640_i2c_transfer(dev, msgs, ARRAY_SIZE(msgs));
+	if (ret < 0)
+		return ret;
+
+	stats->timestampNs = ktime_get_ns();
+	stats->exposure = ((aec[0] & 0x0f) << 16) | (aec[1] << 8) | aec[2];
+	stats->gain = ((gain[0] & 0x03) << 8) | gain[1];
+	for (i = 0; i < 3; i++)
+		stats->awbGain[i] = ((awb[2 * i] & 0x0f) << 8) | awb[2 * i + 1];
+	stats->avgLuma = luma;
+
+	stats->flags = 0;
+	/* 0x3a0f is the upper and 0x3a10 the lower stable limit */
+	if (luma <= stable[0] && luma >= stable[1])
+		stats->flags |= VCAM_STATS_AEC_STABLE;
+	if (aec_ctrl & 0x04)
+		stats->flags |= VCAM_STATS_NIGHTMODE;
+	if (aec[3] & 0x03)
+		stats->flags |= VCAM_STATS_AEC_MANUAL;
+	if (awb[6] & 0x01)
+		stats->flags |= VCAM_STATS_AWB_MANUAL;
+
+	return 0;
+}
+
+/* ov5640_set_exposure_gain
+ * Select automatic or manual exposure. Manual exposure and gain are
+ * written inside group hold so they take effect on the same frame.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+int ov5640_set_exposure_gain(struct device *dev, bool autoexp, u32 exposure, u16 gain)
+{
+	struct reg_value regs[] = {
+		{ 0x3503, 0x03 },	/* manual AEC/AGC */
+		{ 0x3212, 0x00 },	/* group 0 hold start */
+		{ 0x3500, (exposure >> 16) & 0x0f },
+		{ 0x3501, (exposure >> 8) & 0xff },
+		{ 0x3502, exposure & 0xf0 },
+		{ 0x350a, (gain >> 8) & 0x03 },
+		{ 0x350b, gain & 0xff },
+		{ 0x3212, 0x10 },	/* group 0 hold end */
+		{ 0x3212, 0xa0 },	/* group 0 launch */
+	};
+	struct reg_value aec_auto = { 0x3503, 0x00 };
+
+	if (autoexp)
+		return ov5640_doi2cwrite(dev, &aec_auto, 1);
+
+	return ov5640_doi2cwrite(dev, regs, ARRAY_SIZE(regs));
+}
+
+/* ov5640_get_exposure_gain
+ * Read current exposure (1/16 lines) and gain
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+int ov5640_get_exposure_gain(struct device *dev, u32 *exposure, u16 *gain)
+{
+	struct ov5640_ae_state ae;
+	int ret = ov5640_get_ae_state(dev, &ae);
+
+	if (ret)
+		return ret;
+
+	*exposure = ae.exposure;
+	*gain = ae.gain;
+	return 0;
+}
+
+/* ov5640_flash_exposure
+ *
+ * Scale the ambient exposure and gain product so the torch lit luma
+ * reaches OV5640_FLASH_TARGET_LUMA. Exposure is used up to the frame
+ * length before gain is added.
+ *
+ * Returns 0 on success
+ *         -ERANGE if the torch lit frame is too dark or clipped to meter
+ */
+static int ov5640_flash_exposure(struct device *dev, const VCAMIOCTLSTATS *ambient,
+				 const VCAMIOCTLSTATS *lit, u32 *exposure, u16 *gain)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	u32 max_exposure = (ov5640_current_timing(data)->vts - 4) * 16;
+	u64 product;
+
+	if (lit->avgLuma < OV5640_FLASH_MIN_LUMA || lit->avgLuma > OV5640_FLASH_MAX_LUMA)
+		return -ERANGE;
+
+	product = div_u64((u64)ambient->exposure * max(ambient->gain, 0x10U) *
+			  OV5640_FLASH_TARGET_LUMA, lit->avgLuma);
+
+	if (product <= (u64)max_exposure * 0x10) {
+		*exposure = max_t(u32, div_u64(product, 0x10), 0x10);
+		*gain = 0x10;
+	} else {
+		*exposure = max_exposure;
+		*gain = min_t(u64, DIV_ROUND_UP_ULL(product, max_exposure), OV5640_FLASH_MAX_GAIN);
+	}
+	return 0;
+}
+
+/* ov5640_flash_meter
+ *
+ * Switch the torch on with pre-flash metering: exposure and gain are
+ * frozen at the ambient values while the torch comes on, so the change
+ * in average luma is the torch contribution. The flash exposure is then
+ * computed from both bulk statistics reads and written in one group hold.
+ * Falls back to OV5640_FLASH_FALLBACK_EXPOSURE if metering fails.
+ * Called with data->sem held.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_flash_meter(struct device *dev, VCAMIOCTLFLASH *flash)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	VCAMIOCTLFLASHMETERING *m = &data->flash_metering;
+	VCAMIOCTLSTATS ambient, lit;
+	u32 exposure;
+	u16 gain;
+	int meter, ret;
+
+	memset(m, 0, sizeof(*m));
+
+	meter = ov5640_read_stats(dev, &ambient);
+	if (meter == 0)
+		meter = ov5640_set_exposure_gain(dev, false, ambient.exposure, ambient.gain);
+
+	ret = data->ops.set_torchstate(dev, flash);
+	if (ret)
+		return ret;
+
+	if (meter == 0) {
+		msleep(DIV_ROUND_UP(OV5640_FLASH_METER_FRAMES * ov5640_frame_period_us(dev), 1000));
+		meter = ov5640_read_stats(dev, &lit);
+	}
+	if (meter == 0) {
+		m->ambientLuma = ambient.avgLuma;
+		m->torchLuma = lit.avgLuma;
+		meter = ov5640_flash_exposure(dev, &ambient, &lit, &exposure, &gain);
+	}
+	if (meter == 0)
+		meter = ov5640_set_exposure_gain(dev, false, exposure, gain);
+
+	if (meter == 0) {
+		m->bMetered = TRUE;
+		m->exposure = exposure;
+		m->gain = gain;
+		dev_dbg(dev, "Flash metering luma %u -> %u, exposure 0x%x gain 0x%x\n",
+			m->ambientLuma, m->torchLuma, exposure, gain);
+		return 0;
+	}
+
+	dev_warn(dev, "Flash metering failed (%i), using fixed exposure\n", meter);
+	m->exposure = OV5640_FLASH_FALLBACK_EXPOSURE;
+	m->gain = 0x10;
+	/* held in manual mode, AEC would overwrite it on the next frame */
+	return ov5640_set_exposure_gain(dev, false, OV5640_FLASH_FALLBACK_EXPOSURE, 0x10);
+}
+
+/* ov5640_nightmode_work
+ *
+ * Night mode controller. While in draft mode, the scene is evaluated every
+ * OV5640_NIGHTMODE_PERIOD_MS from the exposure, gain and average luminance.
+ * Night mode (lower frame rate, longer exposure) is enabled when AEC needs
+ * more than OV5640_NIGHTMODE_ON_LEVEL full frames of light at unity gain,
+ * and disabled again below OV5640_NIGHTMODE_OFF_LEVEL unless the image is
+ * still dark. The work never sleeps; if a mode switch holds the device it
+ * retries shortly.
+ */
+static void ov5640_nightmode_work(struct kthread_work *work)
+{
+	struct vcam_data *data = container_of(to_vcam_work(work), struct vcam_data, nightmode_work);
+	struct device *dev = data->dev;
+	const struct ov5640_mode_timing *timing;
+	struct ov5640_ae_state ae;
+	u8 aec_ctrl, luma;
+	bool night, want;
+	u64 level;
+
+	vcam_work_start(data, to_vcam_work(work));
+
+	if (down_trylock(&data->sem)) {
+		vcam_queue_work(data, &data->nightmode_work,
+				msecs_to_jiffies(OV5640_NIGHTMODE_BUSY_MS));
+		return;
+	}
+
+	/* stills run at a fixed rate */
+	if (!data->powered || data->cam_mode != VCAM_DRAFT)
+		goto out;
+	/* a carried AEC state is not handed back to auto yet */
+	if (data->ae_held)
+		goto again;
+
+	if (ov5640_read_reg(dev, OV5640_AEC_CTRL00, &aec_ctrl) < 0 ||
+	    ov5640_read_reg(dev, OV5640_AVG_READOUT, &luma) < 0 ||
+	    ov5640_get_ae_state(dev, &ae))
+		goto again;
+
+	night = aec_ctrl & 0x04;
+	timing = ov5640_current_timing(data);
+	/* 1/16 lines times 1/16 gain steps, in full frames at unity gain */
+	level = div_u64((u64)ae.exposure * ae.gain, 256 * timing->vts);
+
+	if (disable_nightmode)
+		want = false;
+	else if (night)
+		want = level > OV5640_NIGHTMODE_OFF_LEVEL || luma < OV5640_NIGHTMODE_DARK_LUMA;
+	else
+		want = level >= OV5640_NIGHTMODE_ON_LEVEL;
+
+	if (want != night) {
+		dev_dbg(dev, "nightmode %s, level %llu luma 0x%02x\n", want ? "on" : "off", level, luma);
+		if (ov5640_nightmode_enable(dev, want))
+			dev_err(dev, "Failed to %s nightmode\n", want ? "enable" : "disable");
+	}
+
+again:
+	vcam_queue_work(data, &data->nightmode_work,
+			msecs_to_jiffies(OV5640_NIGHTMODE_PERIOD_MS));
+out:
+	up(&data->sem);
+}
+
+/* ov5640_nightmode_trigger
+ *
+ * Start the night mode controller, or let a pending evaluation stand so
+ * repeated mode switches do not stack up work
+ */
+static void ov5640_nightmode_trigger(struct device *dev, unsigned int frames)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+
+	vcam_queue_work(data, &data->nightmode_work,
+			usecs_to_jiffies(frames * ov5640_frame_period_us(dev)));
+}
+
+
+/* ov5640_set_5mp
+ *
+ * ae, if not NULL, is the AEC/AWB state captured before the switch. It is
+ * rescaled and written as a held starting point before streaming.
+ *
+ * returns 0 on success
+ *         <0, (or >0) on  error...
+ *
+ * sets modes ov5640_init_settings_9fps_5MP
+ *            ov5640_edge_enhancement
+ *            ov5640_flipimage      - default flip of sensor??
+ *            ov5640_mirror_enable  - default mirror of sensor??
+ *                image flip and mirror enable, might also be set in ov5640_init_settings_9fps_5MP and similar structs...
+ *
+ */
+static int ov5640_set_5mp(struct device *dev, const struct ov5640_ae_state *ae)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	int ret;
+
+	bool ov5640_using_mipi_interface = !data->profile.parallel_interface;
+
+	data->switch_start_ns = ktime_get_ns();
+	ret = ov5640_enable_stream(dev, FALSE);
+	if (ret) {
+		dev_err(dev, "Failed to stop stream\n");
+		return ret;
+	}
+
+	/* Initialize camera settings */
+	data->still_fps = ov5640_select_still_fps(dev);
+	if (ov5640_using_mipi_interface) {
+		ret = ov5640_run_program(dev, ov5640_init_setting_9fps_5MP);
+		if (ret == 0 && data->still_fps == 15)
+			ret = ov5640_run_program(dev, ov5640_setting_15fps_5MP);
+	} else {
+		/* the DVP 5MP program builds on the interface setup */
+		if (data->cam_mode == VCAM_UNDEFINED)
+			ret = ov5640_initcsicamera(dev);
+		if (ret == 0)
+			ret = ov5640_run_program(dev, ov5640_setting_dvp_8fps_5MP);
+	}
+
+	if (ret) {
+		dev_err(dev, "Failed to set %s 5MP mode\n", ov5640_using_mipi_interface ? "MIPI" : "parallell");
+		return ret;
+	}
+
+	/* Write model specific configuration */
+	ret = ov5640_set_sensor_model_conf(dev);
+	if (ret)
+		return ret;
+
+	if (data->edge_enhancement) {
 		ret = ov5640_doi2cwrite(dev, &ov5640_edge_enhancement, 1);
 		if (ret) {
 			dev_err(dev, "Failed to enable edge enhancement\n");
@@ -1575,42 +1825,274 @@ static int ov5640_set_5mp(struct device *dev)
 		}
 	}
 
-	ov5640_enable_stream(dev, TRUE);
-	return 0;
+	ret = ov5640_set_still_format(dev);
+	if (ret) {
+		dev_err(dev, "Failed to set still format %d\n", data->still_mode.eStillMode);
+		return ret;
+	}
+
+	/* the 5MP programs configure YUV422 */
+	data->raw_on = false;
+	ret = ov5640_set_output_format(dev, data->out_format.eStillFormat);
+	if (ret) {
+		dev_err(dev, "Failed to set still output format %d\n", data->out_format.eStillFormat);
+		return ret;
+	}
+
+	if (ae && ov5640_set_ae_state(dev, ae, ov5640_find_timing(data, 0))) {
+		dev_warn(dev, "Failed to carry exposure to 5MP mode\n");
+		ae = NULL;
+	}
+
+	ret = ov5640_enable_stream(dev, TRUE);
+	if (ret) {
+		dev_err(dev, "Failed to start stream\n");
+		return ret;
+	}
+
+	data->cam_mode = VCAM_STILL;
+	data->switch_end_ns = ktime_get_ns();
+	data->switch_gen++;
+	vcam_status_publish(data);
+	vcam_frames_restart(data);
+	if (ae)
+		ov5640_hold_ae(dev, ae_hold_frames);
+	return 0;
+}
+
+
+/* ov5640_set_output_format
+ *
+ * Write the output format on top of the mode program. YUV422 is only
+ * written when leaving RAW, the mode programs start out in YUV422.
+ * RAW also sets the MIPI bit mode in 0x3034, leaving RAW restores the
+ * value the mode program left there.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_set_output_format(struct device *dev, VCAM_OutputFormat fmt)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	const u8 *prog;
+	u8 pll_ctrl;
+	int ret;
+
+	switch (fmt) {
+	case VCAM_FMT_RAW8:
+		prog = ov5640_setting_raw8;
+		pll_ctrl = 0x08;
+		break;
+	case VCAM_FMT_RAW10:
+		prog = ov5640_setting_raw10;
+		pll_ctrl = 0x0a;
+		break;
+	default:
+		if (!data->raw_on)
+			return 0;
+		prog = ov5640_setting_yuv422;
+		pll_ctrl = data->raw_pll_ctrl;
+		break;
+	}
+
+	if (!data->raw_on) {
+		ret = ov5640_read_reg(dev, 0x3034, &data->raw_pll_ctrl);
+		if (ret)
+			return ret;
+	}
+	if (fmt != VCAM_FMT_YUV422)
+		pll_ctrl |= data->raw_pll_ctrl & 0xf0;
+
+	ret = ov5640_run_program(dev, prog);
+	if (ret == 0)
+		ret = ov5640_write_reg(dev, 0x3034, pll_ctrl);
+	if (ret == 0)
+		data->raw_on = fmt != VCAM_FMT_YUV422;
+	return ret;
+}
+
+/* ov5640_set_jpeg
+ *
+ * Switch the JPEG encoder and its clocks on or off. Called after the mode
+ * program and the mirror setting, which both write 0x3821.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_set_jpeg(struct device *dev, bool enable, u8 qscale)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct reg_value jpeg[] = {
+		{ 0x3002, enable ? 0x00 : 0x1c },	/* JFIFO and JPEG out of reset */
+		{ 0x3006, enable ? 0xff : 0xc3 },	/* JPEG clocks */
+		{ OV5640_JPG_QSCALE, qscale },
+	};
+	int ret;
+
+	ret = ov5640_doi2cwrite(dev, jpeg, ARRAY_SIZE(jpeg));
+	if (ret == 0)
+		ret = ov5640_mod_reg(dev, OV5640_TIMING_TC_REG21, 0x20, enable ? 0x20 : 0x00);
+	if (ret == 0)
+		data->jpeg_on = enable;
+	return ret;
+}
+
+/* ov5640_set_still_format
+ *
+ * Apply data->still_mode on top of the 5MP mode program: scale the output
+ * down for the small modes and enable JPEG for the JPEG modes.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_set_still_format(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	VCAM_StillMode mode = data->still_mode.eStillMode;
+	unsigned int quality = data->still_mode.quality;
+	u8 qscale = OV5640_JPEG_QS_DEFAULT;
+	u8 size[4];
+	bool jpeg;
+	int ret;
+
+	if (mode == VCAM_SMALL_YCbCr || mode == VCAM_SMALL_JPEG) {
+		size[0] = OV5640_SMALL_STILL_WIDTH >> 8;
+		size[1] = OV5640_SMALL_STILL_WIDTH & 0xff;
+		size[2] = OV5640_SMALL_STILL_HEIGHT >> 8;
+		size[3] = OV5640_SMALL_STILL_HEIGHT & 0xff;
+		ret = ov5640_write_regs(dev, OV5640_TIMING_DVPHO, size, sizeof(size));
+		if (ret == 0)
+			ret = ov5640_mod_reg(dev, OV5640_ISP_CONTROL01, 0x20, 0x20);
+		if (ret)
+			return ret;
+	}
+
+	jpeg = mode == VCAM_SMALL_JPEG || mode == VCAM_LARGE_JPEG;
+	if (!jpeg && !data->jpeg_on)
+		return 0;
+
+	/* quality 100 is the finest scale, 1 the coarsest */
+	if (quality)
+		qscale = OV5640_JPEG_QS_MIN + (100 - quality) *
+			 (OV5640_JPEG_QS_MAX - OV5640_JPEG_QS_MIN) / 99;
+
+	return ov5640_set_jpeg(dev, jpeg, qscale);
+}
+
+/* ov5640_set_stillmode
+ *
+ * Select the still format, switching again if in VCAM_STILL.
+ * Called with data->sem held.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_set_stillmode(struct device *dev, const VCAMIOCTLSTILLMODE *mode)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct ov5640_ae_state ae;
+
+	switch (mode->eStillMode) {
+	case VCAM_SMALL_YCbCr:
+	case VCAM_LARGE_YCbCr:
+	case VCAM_SMALL_JPEG:
+	case VCAM_LARGE_JPEG:
+		break;
+	default:
+		return ERROR_NOT_SUPPORTED;
+	}
+	if (mode->quality > 100)
+		return -EINVAL;
+	if (data->out_format.eStillFormat != VCAM_FMT_YUV422 &&
+	    mode->eStillMode != VCAM_LARGE_YCbCr)
+		return -EINVAL;
+
+	data->still_mode = *mode;
+	if (data->cam_mode != VCAM_STILL)
+		return 0;
+
+	return ov5640_set_5mp(dev, ov5640_capture_ae(dev, &ae));
 }
 
+/* ov5640_set_format
+ *
+ * Select the output format of the draft and still modes and reprogram the
+ * current mode if its format changed.
+ *
+ * Returns 0 on success
+ *         ERROR_NOT_SUPPORTED for RAW on the parallel interface or an ISP
+ *         scaled draft FOV
+ *         -EINVAL for an unknown format, or RAW with a scaled or JPEG still
+ *         negative on other error
+ */
+static int ov5640_set_format(struct device *dev, const VCAMIOCTLFORMAT *fmt)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	VCAMIOCTLFORMAT old = data->out_format;
+	struct ov5640_ae_state ae;
+	int ret;
+
+	if (fmt->eDraftFormat > VCAM_FMT_RAW10 || fmt->eStillFormat > VCAM_FMT_RAW10)
+		return -EINVAL;
+	if (fmt->eDraftFormat == VCAM_FMT_YUV422 && fmt->eStillFormat == VCAM_FMT_YUV422)
+		goto store;
+
+	if (data->profile.parallel_interface)
+		return ERROR_NOT_SUPPORTED;
+	/* data->fov is the draft mode the next VCAM_DRAFT switch returns to */
+	if (fmt->eDraftFormat != VCAM_FMT_YUV422 &&
+	    ov5640_find_timing(data, data->fov)->isp_scaled)
+		return ERROR_NOT_SUPPORTED;
+	if (fmt->eStillFormat != VCAM_FMT_YUV422 &&
+	    data->still_mode.eStillMode != VCAM_LARGE_YCbCr)
+		return -EINVAL;
+
+store:
+	data->out_format = *fmt;
+
+	if (data->cam_mode == VCAM_DRAFT && fmt->eDraftFormat != old.eDraftFormat)
+		ret = ov5640_set_fov(dev, data->fov, ov5640_capture_ae(dev, &ae));
+	else if (data->cam_mode == VCAM_STILL && fmt->eStillFormat != old.eStillFormat)
+		ret = ov5640_set_5mp(dev, ov5640_capture_ae(dev, &ae));
+	else
+		ret = 0;
+
+	if (ret)
+		data->out_format = old;
+	return ret;
+}
 
 /* ov5640_set_fov
  *
+ * ae, if not NULL, is the AEC/AWB state captured before the switch. It is
+ * rescaled and written as a held starting point before streaming, so the
+ * first frames are exposed right without reconverging from defaults.
  *
  * returns 0 on success
  *         <0, (or >0) on  error...
  *         ERROR_NOT_SUPPORTED, setting not allowed..
  *
  */
-static int ov5640_set_fov(struct device *dev, int fov)
+static int ov5640_set_fov(struct device *dev, int fov, const struct ov5640_ae_state *ae)
 {
 	struct vcam_data *data = dev_get_drvdata(dev);
 	int ret = ERROR_NOT_SUPPORTED;
-	int elements;
-	struct reg_value *setting;
+	int stream_ret;
+	const u8 *setting;
 
 	switch (fov) {
 	case 54:
 		setting = ov5640_setting_30fps_1280_960_HFOV54;
-		elements = OV5640_SETTING_30FPS_1280_960_HFOV54_ELEMENTS;
 		ret = 0;
 		break;
 
 	case 39:
 		setting = ov5640_setting_30fps_1280_960_HFOV39;
-		elements = OV5640_SETTING_30FPS_1280_960_HFOV39_ELEMENTS;
 		ret = 0;
 		break;
 
 	case 28:
 		setting = ov5640_setting_30fps_1280_960_HFOV28;
-		elements = OV5640_SETTING_30FPS_1280_960_HFOV28_ELEMENTS;
 		ret = 0;
 		break;
 
@@ -1619,23 +2101,143 @@ static int ov5640_set_fov(struct device *dev, int fov)
 		ret = ERROR_NOT_SUPPORTED;
 		break;
 	}
+	if (ret == 0 && data->out_format.eDraftFormat != VCAM_FMT_YUV422 &&
+	    ov5640_find_timing(data, fov)->isp_scaled) {
+		dev_err(dev, "VCAM: fov %d is scaled in the ISP, no RAW output\n", fov);
+		ret = ERROR_NOT_SUPPORTED;
+	}
 	if (ret == 0) {
 		dev_info(dev, "Change fov to %i\n", fov);
-		ov5640_set_sensor_model_conf(dev);
-		ov5640_enable_stream(dev, FALSE);
-		ret = ov5640_doi2cwrite(dev, setting, elements);
+		data->switch_start_ns = ktime_get_ns();
+		ret = ov5640_set_sensor_model_conf(dev);
+		if (ret == 0)
+			ret = ov5640_enable_stream(dev, FALSE);
+		if (ret == 0)
+			ret = ov5640_run_program(dev, setting);
+		if (ret == 0 && data->profile.parallel_interface)
+			ret = ov5640_run_program(dev, ov5640_setting_dvp_draft);
+		if (ret == 0 && data->profile.parallel_interface && fov == 39)
+			ret = ov5640_run_program(dev, ov5640_setting_dvp_15fps_HFOV39);
+		if (ret == 0 && data->jpeg_on)
+			ret = ov5640_set_jpeg(dev, false, OV5640_JPEG_QS_DEFAULT);
+		if (ret == 0)
+			ret = ov5640_set_output_format(dev, data->out_format.eDraftFormat);
+
+		if (ret == 0 && ae && ov5640_set_ae_state(dev, ae, ov5640_find_timing(data, fov))) {
+			dev_warn(dev, "Failed to carry exposure to fov %i\n", fov);
+			ae = NULL;
+		}
 
-		ov5640_enable_stream(dev, TRUE);
+		/* restart streaming even if the switch failed */
+		stream_ret = ov5640_enable_stream(dev, TRUE);
+		if (ret == 0)
+			ret = stream_ret;
 
 		if (ret == 0) {
-			g_vcamFOV = fov;
-			schedule_work(&data->nightmode_work);
+			data->fov = fov;
+			data->cam_mode = VCAM_DRAFT;
+			data->switch_end_ns = ktime_get_ns();
+			data->switch_gen++;
+			vcam_status_publish(data);
+			vcam_frames_restart(data);
+			if (ae)
+				ov5640_hold_ae(dev, ae_hold_frames);
+			/* evaluate the scene once AEC has settled in the new mode */
+			ov5640_nightmode_trigger(dev, ae_hold_frames + 2);
 		}
 	}
 
 	return ret;
 }
 
+/* ov5640_settle
+ *
+ * Wait for the new mode to deliver a usable frame. With carried AEC/AWB
+ * that is the second frame, otherwise wait fallback_ms for AEC to converge.
+ */
+static void ov5640_settle(struct device *dev, unsigned int fallback_ms)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+
+	if (data->ae_held)
+		msleep_interruptible(DIV_ROUND_UP(2 * ov5640_frame_period_us(dev), 1000));
+	else
+		msleep_interruptible(fallback_ms);
+}
+
+/* ov5640_grab_still
+ *
+ * Switch to 5MP with exposure and white balance carried over from the
+ * draft mode and return once the first fully exposed still frame is
+ * available. The sensor reverts to draft automatically after
+ * still_hold_frames frames. Called with data->sem held.
+ *
+ * returns 0 on success
+ *         <0 on error
+ */
+static int ov5640_grab_still(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct ov5640_ae_state ae;
+	int ret;
+
+	data->grab_pending = false;
+
+	ret = ov5640_set_5mp(dev, ov5640_capture_ae(dev, &ae));
+	if (ret)
+		return ret;
+
+	/* keep the carried exposure for the whole still, the revert
+	 * reschedules the release for the draft mode
+	 */
+	if (data->ae_held)
+		ov5640_hold_ae(dev, still_hold_frames + ae_hold_frames);
+
+	/* The first frame after stream on is only partly exposed */
+	msleep_interruptible(DIV_ROUND_UP(2 * ov5640_frame_period_us(dev), 1000));
+
+	data->grab_pending = true;
+	data->grab_gen++;
+	vcam_mod_work(data, &data->still_revert_work,
+		      usecs_to_jiffies(still_hold_frames * ov5640_frame_period_us(dev)));
+	return 0;
+}
+
+/* ov5640_still_revert_work
+ *
+ * Return from a grabbed still to the draft FOV. The 5MP program already
+ * holds the common setup, so only the FOV table is written.
+ */
+static void ov5640_still_revert_work(struct kthread_work *work)
+{
+	struct vcam_data *data = container_of(to_vcam_work(work), struct vcam_data, still_revert_work);
+	struct device *dev = data->dev;
+	struct ov5640_ae_state ae;
+	/* a grab after this point queues the work again */
+	u32 gen = READ_ONCE(data->grab_gen);
+	int ret = 0;
+
+	vcam_work_start(data, to_vcam_work(work));
+
+	down(&data->sem);
+	if (!data->grab_pending || data->cam_mode != VCAM_STILL)
+		goto out;
+	/* a newer grab has queued its own revert while this one waited */
+	if (gen != data->grab_gen)
+		goto out;
+	data->grab_pending = false;
+
+	if (!data->profile.parallel_interface)
+		ret = ov5640_set_sharpening(dev, 0);
+	if (ret == 0)
+		ret = ov5640_set_fov(dev, data->fov, ov5640_capture_ae(dev, &ae));
+
+	if (ret)
+		dev_err(dev, "Failed to revert to draft after still (%i)\n", ret);
+out:
+	up(&data->sem);
+}
+
 /* ov5640_set_sharpening
  *
  *
@@ -1659,19 +2261,314 @@ static int ov5640_set_sharpening(struct device *dev, int enable)
  *
  * Enables testpattern output
  *
+ * Returns 0 on success
+ *         negative on error
  */
-static void ov5640_testpattern_enable(struct device *dev, unsigned char value)
+int ov5640_testpattern_enable(struct device *dev, unsigned char value)
 {
 	if (value  & 0x80) {
 		struct reg_value testimg = { 0x503d, 0x0 };
 		testimg.u8Val = (u8)(value);
 		dev_info(dev, "Enable testpattern 0x%02x\n", testimg.u8Val);
-		ov5640_doi2cwrite(dev, &testimg, 1);
+		return ov5640_doi2cwrite(dev, &testimg, 1);
 	} else {
 		struct reg_value ov5640_testimage_off_reg = { 0x503d, 0x00 };
 		dev_info(dev, "Disable testpattern\n");
-		ov5640_doi2cwrite(dev, &ov5640_testimage_off_reg, 1);
+		return ov5640_doi2cwrite(dev, &ov5640_testimage_off_reg, 1);
+	}
+}
+
+/* 0x503d value of each VCAM_TEST_* mode */
+static const u8 ov5640_test_modes[] = {
+	[VCAM_TEST_OFF] = 0x00,
+	[VCAM_TEST_BARS] = OV5640_TEST_ENABLE,
+	[VCAM_TEST_ROLLING] = OV5640_TEST_ENABLE | OV5640_TEST_ROLLING,
+	[VCAM_TEST_SEQUENCE] = OV5640_TEST_ENABLE | OV5640_TEST_ROLLING,
+};
+
+/* ov5640_test_style
+ *
+ * 0x503d value for frame number frame in VCAM_TEST_SEQUENCE
+ */
+static u8 ov5640_test_style(u64 frame)
+{
+	return ov5640_test_modes[VCAM_TEST_SEQUENCE] |
+	       (do_div(frame, VCAM_TEST_SEQUENCE_LEN) << OV5640_TEST_BAR_STYLE_SHIFT);
+}
+
+/* ov5640_set_test
+ *
+ * Select a VCAM_TEST_* mode. The mode is kept per device and written
+ * again by ov5640_initcamera(). Called with data->sem held.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_set_test(struct device *dev, int mode)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	u8 val;
+	int ret;
+
+	if (mode < VCAM_TEST_OFF || mode >= ARRAY_SIZE(ov5640_test_modes))
+		return -EINVAL;
+	if (mode == VCAM_TEST_SEQUENCE && !data->frames.irq)
+		return ERROR_NOT_SUPPORTED;
+
+	val = ov5640_test_modes[mode];
+	if (mode == VCAM_TEST_SEQUENCE) {
+		spin_lock_irq(&data->frames.lock);
+		val = ov5640_test_style(data->frames.count + 1);
+		spin_unlock_irq(&data->frames.lock);
+	}
+
+	if (data->powered) {
+		ret = ov5640_write_reg(dev, OV5640_PRE_ISP_TEST, val);
+		if (ret)
+			return ret;
+	}
+
+	WRITE_ONCE(data->test_mode, mode);
+	return 0;
+}
+
+/* ov5640_test_frame
+ *
+ * Step VCAM_TEST_SEQUENCE from the VSYNC interrupt thread at the start of
+ * frame number frame, so the next frame carries its own style. This is a
+ * single register write and does not wait for data->sem, a frame missed
+ * under contention would show up as a false duplicate.
+ */
+void ov5640_test_frame(struct device *dev, u64 frame)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+
+	if (READ_ONCE(data->test_mode) != VCAM_TEST_SEQUENCE)
+		return;
+
+	ov5640_write_reg(dev, OV5640_PRE_ISP_TEST, ov5640_test_style(frame + 1));
+}
+
+/* ov5640_queue_controls
+ *
+ * Queue a per frame control request for the VSYNC interrupt thread. A
+ * timestamp target is converted to a frame number here from the measured
+ * frame interval, so later interval drift is not followed.
+ *
+ * Returns 0 on success, requestId filled in
+ *         ERROR_NOT_SUPPORTED without the VSYNC interrupt
+ *         -EBUSY if VCAM_CTRL_QUEUE_LEN requests are pending
+ *         negative on other error
+ */
+static int ov5640_queue_controls(struct device *dev, VCAMIOCTLCONTROLS *ctrl)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct vcam_ctrl_queue *q = &data->ctrl;
+	u64 count, last_ns, avg_ns;
+	int i;
+
+	if (!data->frames.irq)
+		return ERROR_NOT_SUPPORTED;
+	if (!ctrl->mask || (ctrl->mask & ~(VCAM_CTRL_EXPOSURE | VCAM_CTRL_GAIN |
+					   VCAM_CTRL_AWB | VCAM_CTRL_AUTO)))
+		return -EINVAL;
+	if ((ctrl->mask & VCAM_CTRL_EXPOSURE) && ctrl->exposure > 0xfffff)
+		return -EINVAL;
+	if ((ctrl->mask & VCAM_CTRL_GAIN) && ctrl->gain > 0x3ff)
+		return -EINVAL;
+	if ((ctrl->mask & VCAM_CTRL_AWB) &&
+	    (ctrl->awbGain[0] > 0xfff || ctrl->awbGain[1] > 0xfff || ctrl->awbGain[2] > 0xfff))
+		return -EINVAL;
+
+	if (!ctrl->targetFrame && ctrl->targetNs) {
+		spin_lock_irq(&data->frames.lock);
+		count = data->frames.count;
+		last_ns = data->frames.last_ns;
+		avg_ns = data->frames.avg_ns;
+		spin_unlock_irq(&data->frames.lock);
+
+		if (!last_ns || !avg_ns || ctrl->targetNs <= last_ns)
+			ctrl->targetFrame = count + 1;
+		else
+			ctrl->targetFrame = count +
+				div64_u64(ctrl->targetNs - last_ns + avg_ns - 1, avg_ns);
+	}
+
+	spin_lock_irq(&q->lock);
+	if (q->count == VCAM_CTRL_QUEUE_LEN) {
+		spin_unlock_irq(&q->lock);
+		return -EBUSY;
+	}
+	if (++q->next_id == 0)
+		q->next_id = 1;
+	ctrl->requestId = q->next_id;
+
+	/* keep pending sorted by target, requests for the same frame in order */
+	for (i = q->count; i > 0 && q->pending[i - 1].targetFrame > ctrl->targetFrame; i--)
+		q->pending[i] = q->pending[i - 1];
+	q->pending[i] = *ctrl;
+	q->count++;
+	spin_unlock_irq(&q->lock);
+
+	return 0;
+}
+
+/* ov5640_control_status
+ *
+ * Look up a control request in the completion history, then the queue.
+ */
+static void ov5640_control_status(struct device *dev, VCAMIOCTLCONTROLSTATUS *st)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct vcam_ctrl_queue *q = &data->ctrl;
+	u32 id = st->requestId;
+	int i;
+
+	memset(st, 0, sizeof(*st));
+	st->requestId = id;
+	st->result = -ENOENT;
+	if (!id)
+		return;
+
+	spin_lock_irq(&q->lock);
+	for (i = 0; i < VCAM_CTRL_DONE_LEN; i++) {
+		if (q->done[i].requestId == id) {
+			*st = q->done[i];
+			goto out;
+		}
+	}
+	for (i = 0; i < q->count; i++) {
+		if (q->pending[i].requestId == id) {
+			st->result = -EINPROGRESS;
+			break;
+		}
+	}
+out:
+	spin_unlock_irq(&q->lock);
+}
+
+/* ov5640_controls_due
+ *
+ * True if a queued control request has to be written during frame number
+ * frame to latch on its target frame.
+ */
+bool ov5640_controls_due(struct device *dev, u64 frame)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	bool due;
+
+	if (!READ_ONCE(data->ctrl.count))
+		return false;
+
+	spin_lock_irq(&data->ctrl.lock);
+	due = data->ctrl.count &&
+	      data->ctrl.pending[0].targetFrame <= frame + OV5640_CTRL_LATCH_FRAMES;
+	spin_unlock_irq(&data->ctrl.lock);
+
+	return due;
+}
+
+/* ov5640_apply_controls
+ *
+ * Write all control requests due in frame number frame from the VSYNC
+ * interrupt thread, with data->sem held. Requests due together are merged,
+ * later ones win, and written in one group hold launched at the next frame
+ * boundary. The applied frame is taken from the VSYNC count after the
+ * write, so a write that overran into the next frame reports the frame it
+ * really latched on.
+ */
+void ov5640_apply_controls(struct device *dev, u64 frame)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct vcam_ctrl_queue *q = &data->ctrl;
+	VCAMIOCTLCONTROLS due[VCAM_CTRL_QUEUE_LEN];
+	VCAMIOCTLCONTROLSTATUS *st;
+	struct reg_value regs[16];
+	u32 exposure = 0, awb[3] = { 0 };
+	u16 gain = 0;
+	unsigned int mask = 0;
+	u64 applied, applied_ns;
+	int n, i, nregs = 0, ret;
+
+	spin_lock_irq(&q->lock);
+	for (n = 0; n < q->count; n++)
+		if (q->pending[n].targetFrame > frame + OV5640_CTRL_LATCH_FRAMES)
+			break;
+	memcpy(due, q->pending, n * sizeof(due[0]));
+	q->count -= n;
+	memmove(q->pending, q->pending + n, q->count * sizeof(q->pending[0]));
+	spin_unlock_irq(&q->lock);
+
+	if (!n)
+		return;
+
+	for (i = 0; i < n; i++) {
+		if (due[i].mask & VCAM_CTRL_AUTO)
+			mask = VCAM_CTRL_AUTO;
+		if (due[i].mask & VCAM_CTRL_EXPOSURE)
+			exposure = due[i].exposure;
+		if (due[i].mask & VCAM_CTRL_GAIN)
+			gain = due[i].gain;
+		if (due[i].mask & VCAM_CTRL_AWB)
+			memcpy(awb, due[i].awbGain, sizeof(awb));
+		if (due[i].mask & ~VCAM_CTRL_AUTO)
+			mask = (mask & ~VCAM_CTRL_AUTO) | (due[i].mask & ~VCAM_CTRL_AUTO);
+	}
+
+	if (mask & (VCAM_CTRL_EXPOSURE | VCAM_CTRL_GAIN))
+		regs[nregs++] = (struct reg_value) { 0x3503, 0x03 };	/* manual AEC/AGC */
+	if (mask & VCAM_CTRL_AWB)
+		regs[nregs++] = (struct reg_value) { 0x3406, 0x01 };	/* manual AWB */
+	if (mask & ~VCAM_CTRL_AUTO)
+		regs[nregs++] = (struct reg_value) { 0x3212, 0x00 };	/* group 0 hold start */
+	if (mask & VCAM_CTRL_EXPOSURE) {
+		regs[nregs++] = (struct reg_value) { 0x3500, (exposure >> 16) & 0x0f };
+		regs[nregs++] = (struct reg_value) { 0x3501, (exposure >> 8) & 0xff };
+		regs[nregs++] = (struct reg_value) { 0x3502, exposure & 0xf0 };
+	}
+	if (mask & VCAM_CTRL_GAIN) {
+		regs[nregs++] = (struct reg_value) { 0x350a, (gain >> 8) & 0x03 };
+		regs[nregs++] = (struct reg_value) { 0x350b, gain & 0xff };
+	}
+	if (mask & VCAM_CTRL_AWB) {
+		for (i = 0; i < 3; i++) {
+			regs[nregs++] = (struct reg_value) { 0x3400 + 2 * i, (awb[i] >> 8) & 0x0f };
+			regs[nregs++] = (struct reg_value) { 0x3401 + 2 * i, awb[i] & 0xff };
+		}
+	}
+	if (mask & ~VCAM_CTRL_AUTO) {
+		regs[nregs++] = (struct reg_value) { 0x3212, 0x10 };	/* group 0 hold end */
+		regs[nregs++] = (struct reg_value) { 0x3212, 0xa0 };	/* group 0 launch */
+	}
+	if (mask & VCAM_CTRL_AUTO) {
+		regs[nregs++] = (struct reg_value) { 0x3503, 0x00 };	/* auto AEC/AGC */
+		regs[nregs++] = (struct reg_value) { 0x3406, 0x00 };	/* auto AWB */
+	}
+
+	ret = ov5640_doi2cwrite(dev, regs, nregs);
+	/* the request owns AEC/AWB now, do not let a held mode switch release it */
+	if (ret == 0)
+		data->ae_held = false;
+
+	spin_lock_irq(&data->frames.lock);
+	applied = data->frames.count + OV5640_CTRL_LATCH_FRAMES;
+	applied_ns = data->frames.last_ns + OV5640_CTRL_LATCH_FRAMES * data->frames.avg_ns;
+	spin_unlock_irq(&data->frames.lock);
+
+	if (ret)
+		dev_warn_ratelimited(dev, "per frame controls for frame %llu failed %d\n",
+				     due[0].targetFrame, ret);
+
+	spin_lock_irq(&q->lock);
+	for (i = 0; i < n; i++) {
+		st = &q->done[q->done_head];
+		q->done_head = (q->done_head + 1) % VCAM_CTRL_DONE_LEN;
+		st->requestId = due[i].requestId;
+		st->result = ret;
+		st->appliedFrame = ret ? 0 : applied;
+		st->appliedNs = ret ? 0 : applied_ns;
 	}
+	spin_unlock_irq(&q->lock);
 }
 
 /* ov5640_flipimage
@@ -1687,6 +2584,7 @@ int ov5640_flipimage(struct device *dev, bool flip)
 {
 	struct vcam_data *data = dev_get_drvdata(dev);
 	struct reg_value *regval;
+	int ret;
 
 	if ((data->flipped_sensor && !flip) ||
 	    ((!data->flipped_sensor && flip)))
@@ -1694,23 +2592,53 @@ int ov5640_flipimage(struct device *dev, bool flip)
 	else
 		regval = &ov5640_flip_off_reg;
 
-	return ov5640_doi2cwrite(dev, regval, 1);
+	ret = ov5640_doi2cwrite(dev, regval, 1);
+	if (ret == 0) {
+		data->flip = flip;
+		vcam_status_publish(data);
+	}
+	return ret;
 }
 
 
+/* ov5640_set_flip_mirror
+ * Set flip and mirror in one register program
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+int ov5640_set_flip_mirror(struct device *dev, bool flip, bool mirror)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct reg_value regs[2];
+	int ret;
+
+	regs[0] = (data->flipped_sensor != flip) ? ov5640_flip_on_reg : ov5640_flip_off_reg;
+	regs[1] = mirror ? ov5640_mirror_on_reg : ov5640_mirror_off_reg;
+
+	ret = ov5640_doi2cwrite(dev, regs, ARRAY_SIZE(regs));
+	if (ret == 0) {
+		data->flip = flip;
+		data->mirror = mirror;
+		vcam_status_publish(data);
+	}
+	return ret;
+}
+
 /* ov5640_initmipicamera
  * Initialize MIPI attached camera (MIPI interface between OV5640 and FPGA)
+ * ae, if not NULL, is carried over to the 5MP setup
  *
  *
  * Returns 0 on success
  *         else error
  */
-static int ov5640_initmipicamera(struct device *dev)
+static int ov5640_initmipicamera(struct device *dev, const struct ov5640_ae_state *ae)
 {
 	int ret = 0;
 
 	dev_info(dev, "MIPI interface used\n");
-	ret = ov5640_set_5mp(dev);
+	ret = ov5640_set_5mp(dev, ae);
 	if (ret) {
 		dev_err(dev, "Failed to configure MIPI camera interface\n");
 		return ret;
@@ -1731,7 +2659,7 @@ static int ov5640_initcsicamera(struct device *dev)
 	int ret = 0;
 
 	dev_info(dev, "cam, Parallell interface\n");
-	ret = ov5640_doi2cwrite(dev, ov5640_init_interface_csi, OV5640_INIT_INTERFACE_CSI_ELEMENTS);
+	ret = ov5640_run_program(dev, ov5640_init_interface_csi);
 	if (ret) {
 		dev_err(dev, "Failed to configure parallell csi camera interface\n");
 		return ret;
@@ -1754,16 +2682,20 @@ static int ov5640_initcsicamera(struct device *dev)
  */
 static int ov5640_initcamera(struct device *dev)
 {
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct ov5640_ae_state ae_state;
+	/* read before the init tables reset AEC/AWB */
+	const struct ov5640_ae_state *ae = ov5640_capture_ae(dev, &ae_state);
 	int ret = 0;
 
-	if (of_find_property(dev->of_node, VCAM_PARALLELL_INTERFACE, NULL)) {
+	if (data->profile.parallel_interface) {
 		ret = ov5640_initcsicamera(dev);
 		if (ret < 0) {
 			dev_err(dev, "Failed to initialise parallell camera interface\n");
 			return ret;
 		}
 	} else {
-		ret = ov5640_initmipicamera(dev);
+		ret = ov5640_initmipicamera(dev, ae);
 		if (ret < 0) {
 			dev_err(dev, "Failed to initialise MIPI camera interface\n");
 			return ret;
@@ -1776,21 +2708,26 @@ static int ov5640_initcamera(struct device *dev)
 		}
 	}
 
-	ret = ov5640_set_fov(dev, g_vcamFOV);
+	ret = ov5640_set_fov(dev, data->fov, ae);
 	if (ret)
 		return ret;
 
+	if (data->test_mode)
+		ret = ov5640_set_test(dev, data->test_mode);
+
 	return ret;
 }
-/* ov5640_init
+/* ov5640_init_work
  *
- * Start initializing cameras...
+ * Prepare the sensor's deferred work, once at probe
  */
-void ov5640_init(struct device *dev)
+void ov5640_init_work(struct device *dev)
 {
 	struct vcam_data *data = dev_get_drvdata(dev);
 
-	INIT_WORK(&data->nightmode_work, ov5640_nightmode_on_off_work);
+	vcam_work_init(&data->nightmode_work, ov5640_nightmode_work);
+	vcam_work_init(&data->still_revert_work, ov5640_still_revert_work);
+	vcam_work_init(&data->ae_release_work, ov5640_ae_release_work);
 }
 
 /* ov5640_ioctl
@@ -1800,23 +2737,23 @@ int ov5640_ioctl(struct device *dev, int cmd, PUCHAR pBuf, PUCHAR pUserBuf)
 {
 	int ret;
 	struct vcam_data *data = dev_get_drvdata(dev);
-	static int TestActive;
+	struct ov5640_ae_state ae;
 
 	switch (cmd) {
 	case IOCTL_CAM_GET_TEST:
 		{
-			down(&data->sem);
-			((VCAMIOCTLTEST *) pBuf)->bTestMode = TestActive;
+			((VCAMIOCTLTEST *) pBuf)->bTestMode = READ_ONCE(data->test_mode);
 			ret = 0;
-			up(&data->sem);
 		}
 		break;
 
 	case IOCTL_CAM_SET_TEST:
 		{
-			down(&data->sem);
-			TestActive = (((VCAMIOCTLTEST *) pBuf)->bTestMode != 0);
-			ret = 0;
+			if (down_interruptible(&data->sem)) {
+				ret = -ERESTARTSYS;
+				break;
+			}
+			ret = ov5640_set_test(dev, ((VCAMIOCTLTEST *) pBuf)->bTestMode);
 			up(&data->sem);
 		}
 		break;
@@ -1832,19 +2769,33 @@ int ov5640_ioctl(struct device *dev, int cmd, PUCHAR pBuf, PUCHAR pUserBuf)
 			dev_err(dev, "Failed to get sensor models\n");
 			break;
 		}
+		vcam_status_publish(data);
 
 		ret = ov5640_initcamera(dev);
 		break;
 	case IOCTL_CAM_SET_FLASH:
 		{
 			VCAMIOCTLFLASH *pFlashData = (VCAMIOCTLFLASH *) pBuf;
+			bool torch_was_on;
 
 			down(&data->sem);
 
-			ret = data->ops.set_torchstate(dev, pFlashData);
-			/* set fast exposure to compensate for led brightness */
-			if (pFlashData->bTorchOn)
-				ov5640_set_exposure(dev, 0x2000);
+			torch_was_on = data->torch;
+			if (pFlashData->bTorchOn && !torch_was_on) {
+				/* meter the exposure for the torch, AEC is manual from here
+				 * even if metering failed or no torch was found
+				 */
+				data->flash_ae_held = true;
+				ret = ov5640_flash_meter(dev, pFlashData);
+			} else {
+				ret = data->ops.set_torchstate(dev, pFlashData);
+				/* release the torch exposure to AEC */
+				if (ret == 0 && !pFlashData->bTorchOn && data->flash_ae_held) {
+					ret = ov5640_set_exposure_gain(dev, true, 0, 0);
+					if (ret == 0)
+						data->flash_ae_held = false;
+				}
+			}
 
 			up(&data->sem);
 		}
@@ -1854,48 +2805,173 @@ int ov5640_ioctl(struct device *dev, int cmd, PUCHAR pBuf, PUCHAR pUserBuf)
 		{
 			VCAMIOCTLCAMMODE *pMode = (VCAMIOCTLCAMMODE *) pBuf;
 
-			down(&data->sem);
+			if (down_interruptible(&data->sem)) {
+				ret = -ERESTARTSYS;
+				break;
+			}
+			data->grab_pending = false;
+			/* already there, skip the stream restart and nightmode re-evaluation */
+			if (pMode->eCamMode == data->cam_mode &&
+			    (pMode->eCamMode == VCAM_STILL || pMode->eCamMode == VCAM_DRAFT)) {
+				up(&data->sem);
+				ret = 0;
+				break;
+			}
 			switch (pMode->eCamMode) {
 			case VCAM_STILL:
 				/* set camera to 5MP full size mode */
-				ret = ov5640_set_5mp(dev);
-				msleep(800);
+				ret = ov5640_set_5mp(dev, ov5640_capture_ae(dev, &ae));
+				ov5640_settle(dev, 800);
 				break;
 
 			case VCAM_DRAFT:
 				/* restore last known fov */
 				ret = ov5640_initcamera(dev);
-				msleep(500);
+				ov5640_settle(dev, 500);
 				break;
 
 			case VCAM_UNDEFINED:
 			case VCAM_RESET:
 			default:
 				dev_err(dev, "VCAM Unsupported IOCTL_CAM_SET_CAMMODE %d\n", pMode->eCamMode);
+				ret = ERROR_NOT_SUPPORTED;
 				break;
 			}
 			up(&data->sem);
 		}
 		break;
 
+	case IOCTL_CAM_GRAB_STILL:
+		if (down_interruptible(&data->sem)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		ret = ov5640_grab_still(dev);
+		up(&data->sem);
+		break;
+
 	case IOCTL_CAM_SET_FOV:
 		{
 			VCAMIOCTLFOV *pVcamFOV = (VCAMIOCTLFOV *) pBuf;
 
-			down(&data->sem);
-			ret = ov5640_set_fov(dev, pVcamFOV->fov);
+			if (down_interruptible(&data->sem)) {
+				ret = -ERESTARTSYS;
+				break;
+			}
+			data->grab_pending = false;
+			if (data->cam_mode == VCAM_DRAFT && pVcamFOV->fov == data->fov)
+				ret = 0;
+			else
+				ret = ov5640_set_fov(dev, pVcamFOV->fov, ov5640_capture_ae(dev, &ae));
+			up(&data->sem);
+		}
+		break;
+	case IOCTL_CAM_SET_FOCUS:
+		if (down_interruptible(&data->sem)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		ret = ov5640_set_focus(dev, (VCAMIOCTLFOCUS *) pBuf);
+		up(&data->sem);
+		break;
+
+	case IOCTL_CAM_GET_FOCUS:
+		if (down_interruptible(&data->sem)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		ret = ov5640_get_focus(dev, (VCAMIOCTLFOCUS *) pBuf);
+		up(&data->sem);
+		break;
+
+	case IOCTL_CAM_SET_STILLMODE:
+		if (down_interruptible(&data->sem)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		ret = ov5640_set_stillmode(dev, (VCAMIOCTLSTILLMODE *) pBuf);
+		up(&data->sem);
+		break;
+
+	case IOCTL_CAM_GET_STILLMODE:
+		if (down_interruptible(&data->sem)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		*(VCAMIOCTLSTILLMODE *) pBuf = data->still_mode;
+		ret = 0;
+		up(&data->sem);
+		break;
+
+	case IOCTL_CAM_SET_FORMAT:
+		if (down_interruptible(&data->sem)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		ret = ov5640_set_format(dev, (VCAMIOCTLFORMAT *) pBuf);
+		up(&data->sem);
+		break;
+
+	case IOCTL_CAM_GET_FORMAT:
+		if (down_interruptible(&data->sem)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		*(VCAMIOCTLFORMAT *) pBuf = data->out_format;
+		ret = 0;
+		up(&data->sem);
+		break;
+
+	case IOCTL_CAM_GET_FLASH_METERING:
+		if (down_interruptible(&data->sem)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		*(VCAMIOCTLFLASHMETERING *) pBuf = data->flash_metering;
+		ret = 0;
+		up(&data->sem);
+		break;
+
+	case IOCTL_CAM_FOCUS_SWEEP:
+		ret = ov5640_focus_sweep(dev, (VCAMIOCTLFOCUSSWEEP *) pBuf);
+		break;
+
+	case IOCTL_CAM_QUEUE_CONTROLS:
+		ret = ov5640_queue_controls(dev, (VCAMIOCTLCONTROLS *) pBuf);
+		break;
+
+	case IOCTL_CAM_CONTROL_STATUS:
+		ov5640_control_status(dev, (VCAMIOCTLCONTROLSTATUS *) pBuf);
+		ret = 0;
+		break;
+
+	case IOCTL_CAM_GET_STATS:
+		{
+			VCAMIOCTLSTATS *stats = (VCAMIOCTLSTATS *) pBuf;
+
+			if (down_interruptible(&data->sem)) {
+				ret = -ERESTARTSYS;
+				break;
+			}
+			spin_lock_irq(&data->frames.lock);
+			stats->frame = data->frames.count;
+			spin_unlock_irq(&data->frames.lock);
+			ret = ov5640_read_stats(dev, stats);
 			up(&data->sem);
 		}
 		break;
+
 	case IOCTL_CAM_GET_FOV:
 		down(&data->sem);
-		((VCAMIOCTLFOV *) pBuf)->fov = g_vcamFOV;
+		((VCAMIOCTLFOV *) pBuf)->fov = data->fov;
 		ret = 0;
 		up(&data->sem);
 		break;
 	case IOCTL_CAM_MIRROR_ON:
 	case IOCTL_CAM_MIRROR_OFF:
+		down(&data->sem);
 		ret = ov5640_mirror_enable(dev, (cmd == IOCTL_CAM_MIRROR_ON));
+		up(&data->sem);
 		break;
 	case IOCTL_CAM_FLIP_ON:
 	case IOCTL_CAM_FLIP_OFF:
@@ -6,6 +6,26 @@
 #define OV5640_CHIP_ID_LOW_BYTE         0x300B
 #define OV5640_SYSTEM_RESET00           0x3000
 #define OV5640_CLOCK_ENABLE00           0x3004
+#define OV5640_PAD_OUTPUT_ENABLE00      0x3016
+#define OV5640_STROBE_CTRL              0x3B00
+#define OV5640_AF_CMD_MAIN              0x3022
+#define OV5640_AF_CMD_ACK               0x3023
+#define OV5640_AF_CMD_PARA0             0x3024
+#define OV5640_AF_FW_STATUS             0x3029
+#define OV5640_AF_FW_BASE               0x8000
+#define OV5640_TIMING_DVPHO             0x3808	/* output width and height, 4 registers */
+#define OV5640_TIMING_TC_REG21          0x3821	/* [5] JPEG enable */
+#define OV5640_JPG_QSCALE               0x4407	/* [5:0] quantization scale */
+#define OV5640_ISP_CONTROL01            0x5001	/* [5] scale enable */
+#define OV5640_PRE_ISP_TEST             0x503D
+#define OV5640_TEST_ENABLE              0x80
+#define OV5640_TEST_ROLLING             0x40
+#define OV5640_TEST_BAR_STYLE_SHIFT     2	/* [3:2] standard, vertical, horizontal, vertical 2 */
+#define OV5640_VCM_CTRL0                0x3602	/* [7:4] DAC[3:0], [3:0] slew */
+#define OV5640_VCM_CTRL1                0x3603	/* [5:0] DAC[9:4] */
+#define OV5640_AEC_CTRL00               0x3A00
+#define OV5640_AVG_READOUT              0x56A1
+#define OV5640_AEC_STABLE_HIGH          0x3A0F
 #define OV5640_OTP_PROGRAM_CTRL         0x3D20
 #define OV5640_OTP_READ_CTRL            0x3D21
 
@@ -18,16 +38,101 @@
 #define OV5640_SENSOR_MODEL_CSP         "OV5640-A71A_45039C15J"
 #define OV5640_SENSOR_MODEL_HIGH_K_ID   0x02
 
+#define OV5640_REG_SPACE                0x10000
+#define OV5640_BURST_LEN                256
+
+/* Power up timing, datasheet minimum PWDN low to RESETB high and maximum
+ * RESETB high to first SCCB access
+ */
+#define OV5640_PWDN_TO_RESET_US         1000
+#define OV5640_READY_TIMEOUT_US         20000
+
+/* Night mode controller, see ov5640_nightmode_work(). Levels are
+ * exposure lines times gain, relative to one full frame at unity gain.
+ */
+#define OV5640_NIGHTMODE_PERIOD_MS      1000
+#define OV5640_NIGHTMODE_BUSY_MS        100
+#define OV5640_NIGHTMODE_ON_LEVEL       4
+#define OV5640_NIGHTMODE_OFF_LEVEL      1
+#define OV5640_NIGHTMODE_DARK_LUMA      0x10
+
+/* pre-flash metering, see ov5640_flash_meter() */
+#define OV5640_FLASH_METER_FRAMES       3	/* torch settle and one full frame */
+#define OV5640_FLASH_TARGET_LUMA        0x2c	/* middle of the AEC stable range */
+#define OV5640_FLASH_MIN_LUMA           0x08
+#define OV5640_FLASH_MAX_LUMA           0xf0	/* clipped above */
+#define OV5640_FLASH_MAX_GAIN           0x80	/* 8x */
+#define OV5640_FLASH_FALLBACK_EXPOSURE  0x2000
+
+/* group hold writes launched during frame n latch at the start of frame n + 1 */
+#define OV5640_CTRL_LATCH_FRAMES        1
+
+/* MIPI lane rate of ov5640_setting_15fps_5MP */
+#define OV5640_5MP_15FPS_LANE_MBPS      696
+
+/* parallel interface PCLK limit and the 5MP rate of ov5640_setting_dvp_8fps_5MP */
+#define OV5640_DVP_MAX_PCLK_MHZ         96
+#define OV5640_DVP_5MP_FPS              8
+
+/* still formats, see ov5640_set_still_format() */
+#define OV5640_SMALL_STILL_WIDTH        1280
+#define OV5640_SMALL_STILL_HEIGHT       960
+#define OV5640_JPEG_QS_MIN              0x01
+#define OV5640_JPEG_QS_MAX              0x3f
+#define OV5640_JPEG_QS_DEFAULT          0x04
+
+/* AF MCU firmware, see ov5640_af_load() */
+#define OV5640_AF_FW_NAME               "ov5640_af.bin"
+#define OV5640_AF_FW_MAX_SIZE           0x2000
+#define OV5640_AF_READY_TIMEOUT_MS      100
+#define OV5640_AF_ACK_TIMEOUT_MS        100
+
+/* I2C retry policy, see ov5640_i2c_transfer() */
+#define OV5640_I2C_BACKOFF_MIN_US       20
+#define OV5640_I2C_BACKOFF_MAX_US       1000
+#define OV5640_I2C_DEADLINE_US          10000
+
 struct reg_value {
 	u16 u16RegAddr;
 	u8 u8Val;
 };
 int ov5640_doi2cwrite(struct device *dev, struct reg_value *pMode, USHORT elements);
+int ov5640_read_regs(struct device *dev, u16 reg, u8 *val, size_t len);
+int ov5640_write_regs(struct device *dev, u16 reg, const u8 *val, size_t len);
+int ov5640_run_program(struct device *dev, const u8 *prog);
+int ov5640_read_stats(struct device *dev, VCAMIOCTLSTATS *stats);
 int ov5640_flipimage(struct device *dev, bool flip);
-void ov5640_enable_stream(struct device *dev, bool enable);
+int ov5640_enable_stream(struct device *dev, bool enable);
+int ov5640_wait_ready(struct device *dev);
+int ov5640_set_strobe(struct device *dev, bool enable);
+unsigned int ov5640_frame_period_us(struct device *dev);
+unsigned int ov5640_mode_fps(struct device *dev, int fov);
+void ov5640_test_frame(struct device *dev, u64 frame);
+bool ov5640_controls_due(struct device *dev, u64 frame);
+void ov5640_apply_controls(struct device *dev, u64 frame);
 int ov5640_create_sysfs_attributes(struct device *dev);
 void ov5640_remove_sysfs_attributes(struct device *dev);
-void ov5640_init(struct device *dev);
+void ov5640_init_work(struct device *dev);
 int ov5640_ioctl(struct device *dev, int cmd, PUCHAR pBuf, PUCHAR pUserBuf);
+int ov5640_testpattern_enable(struct device *dev, unsigned char value);
+int ov5640_set_flip_mirror(struct device *dev, bool flip, bool mirror);
+int ov5640_set_exposure_gain(struct device *dev, bool autoexp, u32 exposure, u16 gain);
+int ov5640_get_exposure_gain(struct device *dev, u32 *exposure, u16 *gain);
+
+#if IS_ENABLED(CONFIG_DEBUG_FS)
+int ov5640_debugfs_init(struct device *dev);
+void ov5640_debugfs_remove(struct device *dev);
+#else
+static inline int ov5640_debugfs_init(struct device *dev) { return 0; }
+static inline void ov5640_debugfs_remove(struct device *dev) { }
+#endif
+
+#if IS_ENABLED(CONFIG_VIDEO_V4L2_SUBDEV_API)
+int ov5640_v4l2_register(struct device *dev);
+void ov5640_v4l2_unregister(struct device *dev);
+#else
+static inline int ov5640_v4l2_register(struct device *dev) { return 0; }
+static inline void ov5640_v4l2_unregister(struct device *dev) { }
+#endif
 
 #endif
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *   debugfs access to the OV5640 register map
+ *
+ *   vcam/registers  binary file over the 16-bit register address space,
+ *                   seek to a register and read or write any length
+ *   vcam/shadow     text dump of the last value the driver wrote to
+ *                   each register, one "addr value" pair per line
+ *
+ * Copyright: FLIR Systems AB
+ ***********************************************************************/
+
+#include "flir_kernel_os.h"
+#include "vcam_internal.h"
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include "ov5640.h"
+
+/* Register access is split into OV5640_BURST_LEN chunks and data->sem is
+ * dropped between them, so a long dump does not stall the ioctls and the
+ * VSYNC control writes. A failure after the first chunk returns the length
+ * done so far.
+ */
+
+static ssize_t ov5640_registers_read(struct file *file, char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	struct device *dev = file->private_data;
+	struct vcam_data *data = dev_get_drvdata(dev);
+	loff_t pos = *ppos;
+	size_t done, len;
+	u8 *buf;
+	int ret = 0;
+
+	if (pos < 0)
+		return -EINVAL;
+	if (pos >= OV5640_REG_SPACE || !count)
+		return 0;
+
+	count = min_t(size_t, count, OV5640_REG_SPACE - pos);
+	buf = kvmalloc(count, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	for (done = 0; done < count; done += len) {
+		len = min_t(size_t, count - done, OV5640_BURST_LEN);
+		if (down_interruptible(&data->sem)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		ret = ov5640_read_regs(dev, pos + done, buf + done, len);
+		up(&data->sem);
+		if (ret)
+			break;
+	}
+	if (!done)
+		goto out;
+
+	if (copy_to_user(ubuf, buf, done)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	*ppos = pos + done;
+	ret = done;
+out:
+	kvfree(buf);
+	return ret;
+}
+
+static ssize_t ov5640_registers_write(struct file *file, const char __user *ubuf,
+				      size_t count, loff_t *ppos)
+{
+	struct device *dev = file->private_data;
+	struct vcam_data *data = dev_get_drvdata(dev);
+	loff_t pos = *ppos;
+	size_t done, len;
+	u8 *buf;
+	int ret = 0;
+
+	if (pos < 0)
+		return -EINVAL;
+	if (pos >= OV5640_REG_SPACE)
+		return -ENOSPC;
+	if (!count)
+		return 0;
+
+	count = min_t(size_t, count, OV5640_REG_SPACE - pos);
+	buf = vmemdup_user(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	for (done = 0; done < count; done += len) {
+		len = min_t(size_t, count - done, OV5640_BURST_LEN);
+		if (down_interruptible(&data->sem)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		ret = ov5640_write_regs(dev, pos + done, buf + done, len);
+		up(&data->sem);
+		if (ret)
+			break;
+	}
+	if (!done)
+		goto out;
+
+	*ppos = pos + done;
+	ret = done;
+out:
+	kvfree(buf);
+	return ret;
+}
+
+static loff_t ov5640_registers_llseek(struct file *file, loff_t offset, int whence)
+{
+	return fixed_size_llseek(file, offset, whence, OV5640_REG_SPACE);
+}
+
+static const struct file_operations ov5640_registers_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = ov5640_registers_read,
+	.write = ov5640_registers_write,
+	.llseek = ov5640_registers_llseek,
+};
+
+static int ov5640_shadow_show(struct seq_file *s, void *unused)
+{
+	struct device *dev = s->private;
+	struct vcam_data *data = dev_get_drvdata(dev);
+	unsigned int reg;
+
+	if (down_interruptible(&data->sem))
+		return -ERESTARTSYS;
+
+	for_each_set_bit(reg, data->reg_written, OV5640_REG_SPACE)
+		seq_printf(s, "0x%04x 0x%02x\n", reg, data->reg_shadow[reg]);
+
+	up(&data->sem);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(ov5640_shadow);
+
+/* ov5640_debugfs_init
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+int ov5640_debugfs_init(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+
+	data->reg_shadow = devm_kzalloc(dev, OV5640_REG_SPACE, GFP_KERNEL);
+	data->reg_written = devm_kcalloc(dev, BITS_TO_LONGS(OV5640_REG_SPACE),
+					 sizeof(unsigned long), GFP_KERNEL);
+	if (!data->reg_shadow || !data->reg_written) {
+		data->reg_shadow = NULL;
+		return -ENOMEM;
+	}
+
+	data->debugfs = debugfs_create_dir("vcam", NULL);
+	debugfs_create_file("registers", 0600, data->debugfs, dev, &ov5640_registers_fops);
+	debugfs_create_file("shadow", 0400, data->debugfs, dev, &ov5640_shadow_fops);
+
+	return 0;
+}
+
+void ov5640_debugfs_remove(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+
+	debugfs_remove_recursive(data->debugfs);
+	data->debugfs = NULL;
+}
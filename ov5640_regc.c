@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *   Host side register program compiler
+ *
+ *   Compiles the tables in ov5640_tables.h into const byte code programs
+ *   (see ov5640_regc.h), written to stdout as a C header:
+ *
+ *   - writes of a value the register is already known to hold are dropped
+ *   - writes overwritten later in the same segment are dropped
+ *   - consecutive addresses are merged into burst writes
+ *   - invalid entries and soft resets without a following wait fail
+ *     the build
+ *
+ *   A segment ends at every delay, poll and write to a register with side
+ *   effects (system control, reset, AF command, group hold). Those writes
+ *   are never merged or dropped, and a soft reset forgets all known values.
+ *
+ * Copyright: FLIR Systems AB
+ ***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ov5640_regc.h"
+
+enum regc_type {
+	REGC_WRITE,
+	REGC_DELAY,
+	REGC_POLL,
+};
+
+/* { addr, val } is a write, so the tables keep their reg_value layout */
+struct regc_op {
+	unsigned int addr;
+	unsigned int val;
+	enum regc_type op;
+	unsigned int mask;
+	unsigned int arg;	/* delay in us, poll timeout in ms */
+};
+
+#define REGC_DELAY_US(us)		{ .op = REGC_DELAY, .arg = (us) }
+#define REGC_POLL(a, m, v, ms)		{ .addr = (a), .val = (v), .op = REGC_POLL, .mask = (m), .arg = (ms) }
+
+#include "ov5640_tables.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define REG_SPACE 0x10000
+#define SOFT_RESET(op) ((op)->op == REGC_WRITE && (op)->addr == 0x3008 && ((op)->val & 0x80))
+
+static int known[REG_SPACE];	/* value a register holds, -1 if unknown */
+
+static int regc_side_effects(unsigned int addr)
+{
+	return (addr >= 0x3000 && addr <= 0x3003) ||	/* block resets */
+	       addr == 0x3008 ||			/* system control */
+	       addr == 0x3022 || addr == 0x3023 ||	/* AF command */
+	       addr == 0x3212;				/* group hold */
+}
+
+static int regc_barrier(const struct regc_op *op)
+{
+	return op->op != REGC_WRITE || regc_side_effects(op->addr);
+}
+
+static int regc_check(const char *name, const struct regc_op *ops, size_t n)
+{
+	size_t i;
+
+	if (!n) {
+		fprintf(stderr, "ov5640_regc: %s: empty program\n", name);
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		const struct regc_op *op = &ops[i];
+
+		switch (op->op) {
+		case REGC_WRITE:
+			/* 0x0000 is not a sensor register, but what a too
+			 * large element count leaves behind
+			 */
+			if (!op->addr || op->addr >= REG_SPACE || op->val > 0xff) {
+				fprintf(stderr, "ov5640_regc: %s[%zu]: invalid write 0x%x = 0x%x\n",
+					name, i, op->addr, op->val);
+				return -1;
+			}
+			if (SOFT_RESET(op) && (i + 1 == n || ops[i + 1].op == REGC_WRITE)) {
+				fprintf(stderr, "ov5640_regc: %s[%zu]: soft reset without delay or poll\n",
+					name, i);
+				return -1;
+			}
+			break;
+		case REGC_DELAY:
+			if (!op->arg) {
+				fprintf(stderr, "ov5640_regc: %s[%zu]: zero delay\n", name, i);
+				return -1;
+			}
+			break;
+		case REGC_POLL:
+			if (!op->addr || op->addr >= REG_SPACE || op->mask > 0xff || op->val > 0xff ||
+			    (op->val & ~op->mask) || !op->arg || op->arg > OV5640_OP_MAX_ARG) {
+				fprintf(stderr, "ov5640_regc: %s[%zu]: invalid poll\n", name, i);
+				return -1;
+			}
+			break;
+		default:
+			fprintf(stderr, "ov5640_regc: %s[%zu]: unknown op %d\n", name, i, op->op);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* overwritten before the segment ends */
+static int regc_dead_store(const struct regc_op *ops, size_t n, size_t i)
+{
+	size_t j;
+
+	for (j = i + 1; j < n && !regc_barrier(&ops[j]); j++)
+		if (ops[j].addr == ops[i].addr)
+			return 1;
+	return 0;
+}
+
+static void regc_emit_write(unsigned int addr, const unsigned char *data, size_t len)
+{
+	size_t i;
+
+	printf("\tOV5640_OP_WRITE, 0x%02x, 0x%02x, %zu,", addr >> 8, addr & 0xff, len);
+	for (i = 0; i < len; i++)
+		printf("%s0x%02x,", (i % 12) ? " " : "\n\t\t", data[i]);
+	printf("\n");
+}
+
+static int regc_compile(const char *name, const struct regc_op *ops, size_t n)
+{
+	unsigned char burst[OV5640_OP_MAX_BURST];
+	unsigned int burst_addr = 0;
+	size_t burst_len = 0;
+	size_t writes = 0, dropped = 0, bursts = 0, bytes = 1;
+	size_t i;
+
+	if (regc_check(name, ops, n))
+		return -1;
+
+	for (i = 0; i < REG_SPACE; i++)
+		known[i] = -1;
+
+	printf("static const u8 %s[] = {\n", name);
+
+	for (i = 0; i < n; i++) {
+		const struct regc_op *op = &ops[i];
+
+		if (op->op == REGC_WRITE) {
+			writes++;
+			if (!regc_side_effects(op->addr) &&
+			    (known[op->addr] == (int)op->val || regc_dead_store(ops, n, i))) {
+				dropped++;
+				continue;
+			}
+
+			if (SOFT_RESET(op))
+				memset(known, 0xff, sizeof(known));
+			else if (!regc_side_effects(op->addr))
+				known[op->addr] = op->val;
+
+			/* side effect writes are kept on their own */
+			if (burst_len && (regc_side_effects(op->addr) ||
+					  regc_side_effects(burst_addr) ||
+					  op->addr != burst_addr + burst_len ||
+					  burst_len == OV5640_OP_MAX_BURST)) {
+				regc_emit_write(burst_addr, burst, burst_len);
+				bytes += 4 + burst_len;
+				bursts++;
+				burst_len = 0;
+			}
+			if (!burst_len)
+				burst_addr = op->addr;
+			burst[burst_len++] = op->val;
+			continue;
+		}
+
+		if (burst_len) {
+			regc_emit_write(burst_addr, burst, burst_len);
+			bytes += 4 + burst_len;
+			bursts++;
+			burst_len = 0;
+		}
+
+		if (op->op == REGC_DELAY) {
+			unsigned int us = op->arg;
+
+			while (us) {
+				unsigned int chunk = us > OV5640_OP_MAX_ARG ? OV5640_OP_MAX_ARG : us;
+
+				printf("\tOV5640_OP_DELAY, 0x%02x, 0x%02x,\n", chunk >> 8, chunk & 0xff);
+				bytes += 3;
+				us -= chunk;
+			}
+		} else {
+			printf("\tOV5640_OP_POLL, 0x%02x, 0x%02x, 0x%02x, 0x%02x, 0x%02x, 0x%02x,\n",
+			       op->addr >> 8, op->addr & 0xff, op->mask, op->val,
+			       op->arg >> 8, op->arg & 0xff);
+			bytes += 7;
+		}
+	}
+
+	if (burst_len) {
+		regc_emit_write(burst_addr, burst, burst_len);
+		bytes += 4 + burst_len;
+		bursts++;
+	}
+
+	printf("\tOV5640_OP_END,\n};\n");
+	printf("/* %s: %zu writes, %zu dropped, %zu bursts, %zu bytes */\n\n",
+	       name, writes, dropped, bursts, bytes);
+	return 0;
+}
+
+int main(void)
+{
+	int ret = 0;
+
+	printf("/* SPDX-License-Identifier: GPL-2.0-or-later */\n");
+	printf("/* Generated by ov5640_regc from ov5640_tables.h, do not edit */\n");
+	printf("#ifndef OV5640_PROGRAMS_H\n#define OV5640_PROGRAMS_H\n\n");
+	printf("#include \"ov5640_regc.h\"\n\n");
+
+#define REGC_COMPILE(name) \
+	if (regc_compile(#name, name, ARRAY_SIZE(name))) \
+		ret = EXIT_FAILURE;
+	REGC_PROGRAMS(REGC_COMPILE)
+
+	printf("#endif /* OV5640_PROGRAMS_H */\n");
+	return ret;
+}
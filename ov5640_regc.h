@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *   OV5640 register program byte code, generated at build time by
+ *   ov5640_regc from ov5640_tables.h and executed by ov5640_run_program().
+ *   16 bit fields are big endian.
+ *
+ *   OV5640_OP_END
+ *   OV5640_OP_WRITE  addr[2] len data[len]   burst write from addr
+ *   OV5640_OP_DELAY  us[2]                   wait
+ *   OV5640_OP_POLL   addr[2] mask val ms[2]  wait until (reg & mask) == val
+ *
+ *   Shared by the driver and the host side compiler, keep it free of
+ *   kernel and libc types.
+ *
+ * Copyright: FLIR Systems AB
+ ***********************************************************************/
+#ifndef OV5640_REGC_H
+#define OV5640_REGC_H
+
+#define OV5640_OP_END                   0
+#define OV5640_OP_WRITE                 1
+#define OV5640_OP_DELAY                 2
+#define OV5640_OP_POLL                  3
+
+#define OV5640_OP_MAX_BURST             255
+#define OV5640_OP_MAX_ARG               0xffff
+
+#endif /* OV5640_REGC_H */
@@ -0,0 +1,804 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *   OV5640 register tables, compiled by ov5640_regc into the register
+ *   programs executed by ov5640_run_program()
+ *
+ *   { addr, value }                 register write
+ *   REGC_DELAY_US(us)               wait
+ *   REGC_POLL(addr, mask, val, ms)  wait until (reg & mask) == val
+ *
+ *   Only included by the host side compiler, see ov5640_regc.c
+ *
+ * Copyright: FLIR Systems AB
+ ***********************************************************************/
+#ifndef OV5640_TABLES_H
+#define OV5640_TABLES_H
+
+static const struct regc_op ov5640_setting_High_K[] = {
+	{ 0x5180, 0xff },
+	{ 0x5181, 0xf2 },
+	{ 0x5182, 0x0 },
+	{ 0x5183, 0x14 },
+	{ 0x5184, 0x25 },
+	{ 0x5185, 0x24 },
+	{ 0x5186, 0x10 },
+	{ 0x5187, 0x10 },
+	{ 0x5188, 0x10 },
+	{ 0x5189, 0x6d },
+	{ 0x518a, 0x53 },
+	{ 0x518b, 0x90 },
+	{ 0x518c, 0x8c },
+	{ 0x518d, 0x3b },
+	{ 0x518e, 0x2c },
+	{ 0x518f, 0x59 },
+	{ 0x5190, 0x42 },
+	{ 0x5191, 0xf8 },
+	{ 0x5192, 0x4 },
+	{ 0x5193, 0x70 },
+	{ 0x5194, 0xf0 },
+	{ 0x5195, 0xf0 },
+	{ 0x5196, 0x3 },
+	{ 0x5197, 0x1 },
+	{ 0x5198, 0x4 },
+	{ 0x5199, 0x0 },
+	{ 0x519a, 0x4 },
+	{ 0x519b, 0x13 },
+	{ 0x519c, 0x6 },
+	{ 0x519d, 0x9e },
+	{ 0x519e, 0x38 },
+	{ 0x5800, 0x2a },
+	{ 0x5801, 0x1a },
+	{ 0x5802, 0x13 },
+	{ 0x5803, 0x13 },
+	{ 0x5804, 0x1b },
+	{ 0x5805, 0x2b },
+	{ 0x5806, 0x10 },
+	{ 0x5807, 0x9 },
+	{ 0x5808, 0x7 },
+	{ 0x5809, 0x7 },
+	{ 0x580a, 0xa },
+	{ 0x580b, 0x10 },
+	{ 0x580c, 0x8 },
+	{ 0x580d, 0x3 },
+	{ 0x580e, 0x0 },
+	{ 0x580f, 0x0 },
+	{ 0x5810, 0x4 },
+	{ 0x5811, 0x9 },
+	{ 0x5812, 0x9 },
+	{ 0x5813, 0x3 },
+	{ 0x5814, 0x0 },
+	{ 0x5815, 0x0 },
+	{ 0x5816, 0x4 },
+	{ 0x5817, 0x9 },
+	{ 0x5818, 0xd },
+	{ 0x5819, 0x6 },
+	{ 0x581a, 0x3 },
+	{ 0x581b, 0x4 },
+	{ 0x581c, 0x6 },
+	{ 0x581d, 0xd },
+	{ 0x581e, 0x21 },
+	{ 0x581f, 0x11 },
+	{ 0x5820, 0xa },
+	{ 0x5821, 0xa },
+	{ 0x5822, 0x13 },
+	{ 0x5823, 0x23 },
+	{ 0x5824, 0x13 },
+	{ 0x5825, 0x24 },
+	{ 0x5826, 0x24 },
+	{ 0x5827, 0x22 },
+	{ 0x5828, 0x4 },
+	{ 0x5829, 0x10 },
+	{ 0x582a, 0x22 },
+	{ 0x582b, 0x22 },
+	{ 0x582c, 0x22 },
+	{ 0x582d, 0x22 },
+	{ 0x582e, 0x10 },
+	{ 0x582f, 0x22 },
+	{ 0x5830, 0x42 },
+	{ 0x5831, 0x22 },
+	{ 0x5832, 0x22 },
+	{ 0x5833, 0x10 },
+	{ 0x5834, 0x22 },
+	{ 0x5835, 0x22 },
+	{ 0x5836, 0x22 },
+	{ 0x5837, 0x0 },
+	{ 0x5838, 0x12 },
+	{ 0x5839, 0x12 },
+	{ 0x583a, 0x10 },
+	{ 0x583b, 0x10 },
+	{ 0x583c, 0x2 },
+	{ 0x583d, 0xce },
+};
+
+/* Settings from
+ * Rocky/Elektronik/Komponenter/datablad/VCam/Settings/
+ */
+static const struct regc_op ov5640_init_setting_9fps_5MP[] = {
+	{ 0x3103, 0x11 },
+	{ 0x3008, 0x82 },
+	REGC_DELAY_US(5000),	/* soft reset */
+	{ 0x3008, 0x42 },
+	{ 0x3103, 0x03 },
+	{ 0x3017, 0x00 },
+	{ 0x3018, 0x00 },
+	{ 0x3034, 0x18 },
+	{ 0x3035, 0x11 },
+	{ 0x3036, 0x34 },
+	{ 0x3037, 0x13 },
+	{ 0x3108, 0x01 },
+	{ 0x3630, 0x36 },
+	{ 0x3631, 0x0e },
+	{ 0x3632, 0xe2 },
+	{ 0x3633, 0x12 },
+	{ 0x3621, 0xe0 },
+	{ 0x3704, 0xa0 },
+	{ 0x3703, 0x5a },
+	{ 0x3715, 0x78 },
+	{ 0x3717, 0x01 },
+	{ 0x370b, 0x60 },
+	{ 0x3705, 0x1a },
+	{ 0x3905, 0x02 },
+	{ 0x3906, 0x10 },
+	{ 0x3901, 0x0a },
+	{ 0x3731, 0x12 },
+	{ 0x3600, 0x08 },
+	{ 0x3601, 0x33 },
+	{ 0x302d, 0x60 },
+	{ 0x3620, 0x52 },
+	{ 0x371b, 0x20 },
+	{ 0x471c, 0x50 },
+	{ 0x3a13, 0x43 },
+	{ 0x3a17, 0x03 },
+	{ 0x3a18, 0x03 },
+	{ 0x3a19, 0xc0 },	// Changed from ff to c0 by IQL
+	{ 0x3635, 0x13 },
+	{ 0x3636, 0x03 },
+	{ 0x3634, 0x40 },
+	{ 0x3622, 0x01 },
+	{ 0x3c01, 0x34 },
+	{ 0x3c04, 0x28 },
+	{ 0x3c05, 0x98 },
+	{ 0x3c06, 0x00 },
+	{ 0x3c07, 0x07 },
+	{ 0x3c08, 0x00 },
+	{ 0x3c09, 0x1c },
+	{ 0x3c0a, 0x9c },
+	{ 0x3c0b, 0x40 },
+	{ 0x3820, 0x40 },	//Sensor flip=0 and mirror=1
+	{ 0x3821, 0x07 },
+	{ 0x3814, 0x11 },
+	{ 0x3815, 0x11 },
+	{ 0x3800, 0x00 },
+	{ 0x3801, 0x00 },
+	{ 0x3802, 0x00 },
+	{ 0x3803, 0x00 },
+	{ 0x3804, 0x0a },
+	{ 0x3805, 0x3f },
+	{ 0x3806, 0x07 },
+	{ 0x3807, 0x9f },
+	{ 0x3808, 0x0a },
+	{ 0x3809, 0x20 },
+	{ 0x380a, 0x07 },
+	{ 0x380b, 0x98 },
+	{ 0x380c, 0x0b },
+	{ 0x380d, 0x1c },
+	{ 0x380e, 0x07 },
+	{ 0x380f, 0xb0 },
+	{ 0x3810, 0x00 },
+	{ 0x3811, 0x10 },
+	{ 0x3812, 0x00 },
+	{ 0x3813, 0x04 },
+	{ 0x3618, 0x04 },
+	{ 0x3612, 0x2b },
+	{ 0x3708, 0x64 },
+	{ 0x3709, 0x12 },
+	{ 0x370c, 0x00 },
+	{ 0x3a00, 0x7c },	//night_mode
+	{ 0x3a01, 0x01 },
+	{ 0x3a02, 0x0f },
+	{ 0x3a03, 0xff },
+	{ 0x3a05, 0x70 },	//Sigma change from 30 to 70 (161130)
+	{ 0x3a08, 0x01 },
+	{ 0x3a09, 0x27 },
+	{ 0x3a0a, 0x00 },
+	{ 0x3a0b, 0xf6 },
+	{ 0x3a0e, 0x06 },
+	{ 0x3a0d, 0x08 },
+	{ 0x3a14, 0xff },
+	{ 0x3a15, 0xff },
+	{ 0x4001, 0x02 },
+	{ 0x4004, 0x06 },
+	{ 0x3000, 0x20 },	//Leave MCU in reset
+	{ 0x3002, 0x1c },
+	{ 0x3004, 0xdf },	//Disable mcu clock
+	{ 0x3006, 0xc3 },
+	{ 0x300e, 0x45 },	/* MIPI enabled */
+	{ 0x302e, 0x08 },
+	{ 0x4300, 0x32 },
+	{ 0x4837, 0x0a },
+	{ 0x501f, 0x00 },
+	{ 0x440e, 0x00 },
+	{ 0x5000, 0xa7 },
+	{ 0x5001, 0x83 },
+	{ 0x5180, 0xff },
+	{ 0x5181, 0xf2 },
+	{ 0x5182, 0x00 },
+	{ 0x5183, 0x14 },	// [START] Sigma AWB tuning (advanced mode 0x14) (161121)
+	{ 0x5184, 0x25 },	//
+	{ 0x5185, 0x24 },	//
+	{ 0x5186, 0x0b },	//
+	{ 0x5187, 0x0f },	//
+	{ 0x5188, 0x0c },	//
+	{ 0x5189, 0x72 },	//
+	{ 0x518a, 0x63 },	//
+	{ 0x518b, 0xbb },	//
+	{ 0x518c, 0x8c },	//
+	{ 0x518d, 0x3c },	//
+	{ 0x518e, 0x3c },	//
+	{ 0x518f, 0x48 },	//
+	{ 0x5190, 0x45 },	//
+	{ 0x5191, 0xf8 },	//
+	{ 0x5192, 0x04 },	//
+	{ 0x5193, 0x70 },	//
+	{ 0x5194, 0xf0 },	//
+	{ 0x5195, 0xf0 },	//
+	{ 0x5196, 0x03 },	//
+	{ 0x5197, 0x01 },	//
+	{ 0x5198, 0x06 },	//
+	{ 0x5199, 0x9b },	//
+	{ 0x519a, 0x04 },	//
+	{ 0x519b, 0x00 },	//
+	{ 0x519c, 0x04 },	//
+	{ 0x519d, 0x14 },	//
+	{ 0x519e, 0x38 },	// [END] Sigma AWB tuning (advanced mode 0x14) (161121)
+	{ 0x5381, 0x1e },	// [START] Sigma roll back to default CCM, to be finished (161121)
+	{ 0x5382, 0x5b },	//
+	{ 0x5383, 0x08 },	//
+	{ 0x5384, 0x0a },	//
+	{ 0x5385, 0x7e },	//
+	{ 0x5386, 0x88 },	//
+	{ 0x5387, 0x7c },	//
+	{ 0x5388, 0x6c },	//
+	{ 0x5389, 0x10 },	//
+	{ 0x538a, 0x01 },	//
+	{ 0x538b, 0x98 },	// [START] Sigma roll back to default CCM, to be finished (161121)
+	{ 0x5300, 0x08 },
+	{ 0x5301, 0x30 },
+	{ 0x5302, 0x10 },
+	{ 0x5303, 0x00 },
+	{ 0x5304, 0x08 },
+	{ 0x5305, 0x30 },
+	{ 0x5306, 0x08 },
+	{ 0x5307, 0x16 },
+	{ 0x5309, 0x08 },
+	{ 0x530a, 0x30 },
+	{ 0x530b, 0x04 },
+	{ 0x530c, 0x06 },
+	{ 0x5480, 0x01 },
+	{ 0x5481, 0x1f },	// [START] Sigma gamma settings (161130)
+	{ 0x5482, 0x2a },	//
+	{ 0x5483, 0x3c },	//
+	{ 0x5484, 0x61 },	//
+	{ 0x5485, 0x73 },	//
+	{ 0x5486, 0x7e },	//
+	{ 0x5487, 0x88 },	//
+	{ 0x5488, 0x91 },	//
+	{ 0x5489, 0x9a },	//
+	{ 0x548a, 0xa2 },	//
+	{ 0x548b, 0xb1 },	//
+	{ 0x548c, 0xbd },	//
+	{ 0x548d, 0xd0 },	//
+	{ 0x548e, 0xdf },	//
+	{ 0x548f, 0xea },	//
+	{ 0x5490, 0x1d },	// [END] Sigma gamma settings (161130)
+	{ 0x5580, 0x02 },
+	{ 0x5583, 0x40 },
+	{ 0x5584, 0x10 },
+	{ 0x5589, 0x10 },
+	{ 0x558a, 0x00 },
+	{ 0x558b, 0xf8 },
+	{ 0x5800, 0x23 },	// [START] Sigma LENC table (161121)
+	{ 0x5801, 0x14 },	//
+	{ 0x5802, 0x0f },	//
+	{ 0x5803, 0x0f },	//
+	{ 0x5804, 0x12 },	//
+	{ 0x5805, 0x26 },	//
+	{ 0x5806, 0x0c },	//
+	{ 0x5807, 0x08 },	//
+	{ 0x5808, 0x07 },	//
+	{ 0x5809, 0x07 },	//
+	{ 0x580a, 0x08 },	//
+	{ 0x580b, 0x0d },	//
+	{ 0x580c, 0x08 },	//
+	{ 0x580d, 0x03 },	//
+	{ 0x580e, 0x01 },	//
+	{ 0x580f, 0x01 },	//
+	{ 0x5810, 0x07 },	//
+	{ 0x5811, 0x09 },	//
+	{ 0x5812, 0x07 },	//
+	{ 0x5813, 0x03 },	//
+	{ 0x5814, 0x01 },	//
+	{ 0x5815, 0x01 },	//
+	{ 0x5816, 0x07 },	//
+	{ 0x5817, 0x08 },	//
+	{ 0x5818, 0x0d },	//
+	{ 0x5819, 0x08 },	//
+	{ 0x581a, 0x05 },	//
+	{ 0x581b, 0x06 },	//
+	{ 0x581c, 0x08 },	//
+	{ 0x581d, 0x0e },	//
+	{ 0x581e, 0x29 },	//
+	{ 0x581f, 0x17 },	//
+	{ 0x5820, 0x11 },	//
+	{ 0x5821, 0x11 },	//
+	{ 0x5822, 0x15 },	//
+	{ 0x5823, 0x28 },	//
+	{ 0x5824, 0x46 },	//
+	{ 0x5825, 0x26 },	//
+	{ 0x5826, 0x08 },	//
+	{ 0x5827, 0x26 },	//
+	{ 0x5828, 0x64 },	//
+	{ 0x5829, 0x26 },	//
+	{ 0x582a, 0x24 },	//
+	{ 0x582b, 0x21 },	//
+	{ 0x582c, 0x02 },	//
+	{ 0x582d, 0x24 },	//
+	{ 0x582e, 0x06 },	//
+	{ 0x582f, 0x21 },	//
+	{ 0x5830, 0x30 },	//
+	{ 0x5831, 0x21 },	//
+	{ 0x5832, 0x24 },	//
+	{ 0x5833, 0x26 },	//
+	{ 0x5834, 0x24 },	//
+	{ 0x5835, 0x21 },	//
+	{ 0x5836, 0x22 },	//
+	{ 0x5837, 0x26 },	//
+	{ 0x5838, 0x44 },	//
+	{ 0x5839, 0x24 },	//
+	{ 0x583a, 0x26 },	//
+	{ 0x583b, 0x28 },	//
+	{ 0x583c, 0x42 },	//
+	{ 0x583d, 0xff },	// [END] Sigma LENC table (161121)
+	{ 0x5025, 0x00 },
+	{ 0x3a0f, 0x30 },	// Exposure target
+	{ 0x3a10, 0x28 },	//
+	{ 0x3a1b, 0x30 },	//
+	{ 0x3a1e, 0x26 },	//
+	{ 0x3a11, 0x60 },
+	{ 0x3a1f, 0x14 },
+	{ 0x3008, 0x02 }
+};
+
+/*
+ * 15 fps on top of ov5640_init_setting_9fps_5MP, same HTS/VTS with the PLL
+ * multiplier raised from 52 to 87: 15.06 fps at 696 Mbps per MIPI lane,
+ * see OV5640_5MP_15FPS_LANE_MBPS. MIPI pclk period and the AEC band steps
+ * are scaled by the same factor.
+ */
+static const struct regc_op ov5640_setting_15fps_5MP[] = {
+	{ 0x3036, 0x57 },	// PLL multiplier 87
+	{ 0x4837, 0x06 },	// MIPI pclk period
+	{ 0x3a08, 0x01 },	// 50 Hz band step 0x1ec lines
+	{ 0x3a09, 0xec },
+	{ 0x3a0a, 0x01 },	// 60 Hz band step 0x19a lines
+	{ 0x3a0b, 0x9a },
+	{ 0x3a0e, 0x04 },	// 50 Hz max bands in VTS
+	{ 0x3a0d, 0x04 },	// 60 Hz max bands in VTS
+};
+
+/*
+ * Parallel (DVP) interface. ov5640_init_interface_csi is the base setup,
+ * the mode programs below and the FOV programs only change geometry and
+ * clocks on top of it. With 0x3034 in 8 bit mode the DVP PCLK is twice
+ * the pixel clock; YUV422 carries one byte per PCLK, and the PCLK is kept
+ * at or below OV5640_DVP_MAX_PCLK_MHZ.
+ */
+
+/* after a FOV program: 8 bit mode, HFOV54 and HFOV28 run at 30 fps, PCLK 92 MHz */
+static const struct regc_op ov5640_setting_dvp_draft[] = {
+	{ 0x3034, 0x18 },	// SC PLL control, 8 bit
+};
+
+/*
+ * after the HFOV39 program: the ISP scaled 1280 wide output does not fit
+ * the DVP at 30 fps, system divider 2 gives 15 fps at PCLK 96 MHz. AEC
+ * band steps halved accordingly.
+ */
+static const struct regc_op ov5640_setting_dvp_15fps_HFOV39[] = {
+	{ 0x3008, 0x42 },
+	{ 0x3035, 0x22 },	// system clock divider 2
+	{ 0x3a08, 0x00 },	// 50 Hz band step 0xde lines
+	{ 0x3a09, 0xde },
+	{ 0x3a0a, 0x00 },	// 60 Hz band step 0xb9 lines
+	{ 0x3a0b, 0xb9 },
+	{ 0x3a0e, 0x06 },	// 50 Hz max bands in VTS
+	{ 0x3a0d, 0x08 },	// 60 Hz max bands in VTS
+	{ 0x3008, 0x02 },
+};
+
+/*
+ * 5MP still, 2592x1944 with the HTS/VTS of ov5640_init_setting_9fps_5MP
+ * and PLL multiplier 45: 8.04 fps at PCLK 90 MHz. AEC band steps scaled
+ * from the 9 fps table by 45/52.
+ */
+static const struct regc_op ov5640_setting_dvp_8fps_5MP[] = {
+	{ 0x3008, 0x42 },
+	{ 0x3034, 0x18 },	// SC PLL control, 8 bit
+	{ 0x3035, 0x11 },	// system clock divider 1
+	{ 0x3036, 0x2d },	// PLL multiplier 45
+	{ 0x3c07, 0x07 },
+	{ 0x3814, 0x11 },	//Horizontal subsamble increment
+	{ 0x3815, 0x11 },	//Vertical   subsamble increment
+	{ 0x3800, 0x00 }, { 0x3801, 0x00 },	//X address start = 0x0
+	{ 0x3802, 0x00 }, { 0x3803, 0x00 },	//Y address start = 0x0
+	{ 0x3804, 0x0a }, { 0x3805, 0x3f },	//X address end   = 0xa3f
+	{ 0x3806, 0x07 }, { 0x3807, 0x9f },	//Y address end   = 0x79f
+	{ 0x3808, 0x0a }, { 0x3809, 0x20 },	//DVP width  output size = 0xa20   (2592)
+	{ 0x380a, 0x07 }, { 0x380b, 0x98 },	//DVP height output size = 0x798   (1944)
+	{ 0x380c, 0x0b }, { 0x380d, 0x1c },	// Total horizontal size = 0xb1c   (2844)
+	{ 0x380e, 0x07 }, { 0x380f, 0xb0 },	// Total vertical size  =  0x7b0   (1968)
+	{ 0x3810, 0x00 }, { 0x3811, 0x10 },	// ISP horizontal offset = 0x10
+	{ 0x3812, 0x00 }, { 0x3813, 0x04 },	// ISP vertical   offset = 0x4
+	{ 0x3618, 0x04 }, { 0x3612, 0x2b }, { 0x3708, 0x64 },
+	{ 0x3709, 0x12 }, { 0x370c, 0x00 },
+	{ 0x3a02, 0x07 }, { 0x3a03, 0xb0 },	// 60 Hz max exposure, one frame
+	{ 0x3a08, 0x00 }, { 0x3a09, 0xff },	// 50 Hz band step 0xff lines
+	{ 0x3a0a, 0x00 }, { 0x3a0b, 0xd5 },	// 60 Hz band step 0xd5 lines
+	{ 0x3a0e, 0x07 },	// 50 Hz max bands in VTS
+	{ 0x3a0d, 0x09 },	// 60 Hz max bands in VTS
+	{ 0x3a14, 0x07 }, { 0x3a15, 0xb0 },	// 50 Hz max exposure, one frame
+	{ 0x4001, 0x02 }, { 0x4004, 0x06 }, { 0x4713, 0x02 },
+	{ 0x4407, 0x04 }, { 0x460b, 0x35 }, { 0x460c, 0x20 },	// PCLK divider auto
+	{ 0x3824, 0x01 }, { 0x5001, 0x83 },
+	{ 0x3008, 0x02 },
+};
+
+/*
+ * Output format, applied on top of a mode program. RAW takes the Bayer
+ * data after defect pixel correction, past the rest of the ISP. The MIPI
+ * bit mode in 0x3034 is set by ov5640_set_output_format.
+ */
+static const struct regc_op ov5640_setting_raw8[] = {
+	{ 0x4300, 0x00 },	// formatter RAW, BGGR
+	{ 0x501f, 0x03 },	// ISP RAW after DPC
+};
+
+static const struct regc_op ov5640_setting_raw10[] = {
+	{ 0x4300, 0xf8 },	// formatter bypass, 10 bit RAW
+	{ 0x501f, 0x03 },	// ISP RAW after DPC
+};
+
+/* back to the ov5640_init_interface_csi format after RAW */
+static const struct regc_op ov5640_setting_yuv422[] = {
+	{ 0x4300, 0x32 },	// YUV422, YUYV
+	{ 0x501f, 0x00 },	// ISP YUV422
+};
+
+/*
+ * settings based on ov5640_setting_30fps_720P_1280_720
+ *
+ * mode timings from https://confluence-se.flir.net/display/IN/vcam+modes
+ *
+ * vcam fov=55 used with IR lens fov=45
+ */
+static const struct regc_op ov5640_setting_30fps_1280_960_HFOV54[] = {
+	{ 0x3008, 0x42 },
+	{ 0x3035, 0x21 }, { 0x3036, 0x5c }, { 0x3c07, 0x07 },
+	{ 0x3c09, 0x1c }, { 0x3c0a, 0x9c }, { 0x3c0b, 0x40 },
+	{ 0x3814, 0x31 },	//Horizontal subsamble increment
+	{ 0x3815, 0x31 },	//Vertical   subsamble increment
+	{ 0x3800, 0x00 }, { 0x3801, 0x00 },	//X address start = 0x0
+	{ 0x3802, 0x00 }, { 0x3803, 0x04 },	//Y address start = 0x4
+	{ 0x3804, 0x0a }, { 0x3805, 0x3f },	//X address end   = 0xa3f
+	{ 0x3806, 0x07 }, { 0x3807, 0x9b },	//Y address end   = 0x79b
+	{ 0x3808, 0x05 }, { 0x3809, 0x00 },	//DVP width  output size = 0x500   (1280)
+	{ 0x380a, 0x03 }, { 0x380b, 0xc0 },	//DVP height output size = 0x3c0   (960)
+	{ 0x380c, 0x06 }, { 0x380d, 0x40 },	// Total horizontal size = 0x640   ()
+	{ 0x380e, 0x03 }, { 0x380f, 0xd8 },	// Total vertical size  =  0x3d8   (984)
+	{ 0x3810, 0x00 }, { 0x3811, 0x10 },	// ISP horizontal offset = 0x10
+	{ 0x3812, 0x00 }, { 0x3813, 0x00 },	// ISP vertical   offset = 0x0
+	{ 0x3618, 0x00 }, { 0x3612, 0x29 }, { 0x3708, 0x64 },
+	{ 0x3709, 0x52 }, { 0x370c, 0x03 }, { 0x3a02, 0x0f },
+	{ 0x3a03, 0xff }, { 0x3a08, 0x01 }, { 0x3a09, 0xbc },
+	{ 0x3a0a, 0x01 }, { 0x3a0b, 0x72 }, { 0x3a0e, 0x06 },
+	{ 0x3a0d, 0x02 }, { 0x3a14, 0x0f }, { 0x3a15, 0xff },
+	{ 0x4001, 0x02 }, { 0x4004, 0x02 }, { 0x4713, 0x02 },
+	{ 0x4407, 0x04 }, { 0x460b, 0x37 }, { 0x460c, 0x20 },
+	{ 0x3824, 0x04 }, { 0x5001, 0x83 }, { 0x4005, 0x1a },
+	{ 0x3008, 0x02 }, { 0x3503, 0 },
+	{ 0x5688, 0x11 },	// [START] Sigma exposure weights (161130)
+	{ 0x5689, 0x11 },	// keep 0x11 for HFOV28 and HFOV39
+	{ 0x568a, 0x11 },	//
+	{ 0x568b, 0x11 },	//
+	{ 0x568c, 0x11 },	//
+	{ 0x568d, 0x11 },	//
+	{ 0x568e, 0x11 },	//
+	{ 0x568f, 0x11 },	// [END] Sigma exposure weights (161130)
+	{ 0x5186, 0x0b },	// [START] Sigma HFOV54/HFOV28 AWB (161202)
+	{ 0x5187, 0x0f },	//
+	{ 0x5188, 0x0c },	//
+	{ 0x5189, 0x72 },	//
+	{ 0x518a, 0x63 },	//
+	{ 0x518e, 0x3c },	//
+	{ 0x518f, 0x48 },	//
+	{ 0x5190, 0x45 },	//
+	{ 0x5198, 0x06 },	//
+	{ 0x5199, 0x9b },	//
+	{ 0x519c, 0x04 },	//
+	{ 0x519d, 0x14 },	// [END] Sigma HFOV54/HFOV28 AWB (161202)
+};
+
+/*
+ *
+ *
+ * settings based on ov5640_setting_30fps_720P_1280_720
+ *
+ * mode timings from https://confluence-se.flir.net/display/IN/vcam+modes
+ *
+ * vcam fov=39 used with IR lens fov=28
+ */
+static const struct regc_op ov5640_setting_30fps_1280_960_HFOV39[] = {
+	{ 0x3008, 0x42 },
+	{ 0x3035, 0x12 }, { 0x3036, 0x60 }, { 0x3c07, 0x07 },
+	{ 0x3c09, 0x1c }, { 0x3c0a, 0x9c }, { 0x3c0b, 0x40 },
+	{ 0x3814, 0x11 },	//Horizontal subsamble increment
+	{ 0x3815, 0x11 },	//Vertical   subsamble increment
+	{ 0x3800, 0x01 }, { 0x3801, 0x8c },	//X address start = 0x18c
+	{ 0x3802, 0x01 }, { 0x3803, 0x26 },	//Y address start = 0x126
+	{ 0x3804, 0x08 }, { 0x3805, 0xb3 },	//X address end   = 0x8b3
+	{ 0x3806, 0x06 }, { 0x3807, 0x77 },	//Y address end   = 0x677
+	{ 0x3808, 0x05 }, { 0x3809, 0x00 },	//DVP width  output size = 0x500   (1280)
+	{ 0x380a, 0x03 }, { 0x380b, 0xc0 },	//DVP height output size = 0x3c0   (960)
+	{ 0x380c, 0x08 }, { 0x380d, 0x00 },	// Total horizontal size = 0x800   (2048)
+	{ 0x380e, 0x06 }, { 0x380f, 0x00 },	// Total vertical size  =  0x600   (1536)
+	{ 0x3810, 0x00 }, { 0x3811, 0x10 },	// ISP horizontal offset = 0x10
+	{ 0x3812, 0x00 }, { 0x3813, 0x06 },	// ISP vertical   offset = 0x6
+	{ 0x3618, 0x00 }, { 0x3612, 0x29 }, { 0x3708, 0x64 },
+	{ 0x3709, 0x52 }, { 0x370c, 0x03 }, { 0x3a02, 0x0f },
+	{ 0x3a03, 0xff }, { 0x3a08, 0x01 }, { 0x3a09, 0xbc },
+	{ 0x3a0a, 0x01 }, { 0x3a0b, 0x72 }, { 0x3a0e, 0x06 },
+	{ 0x3a0d, 0x02 }, { 0x3a14, 0x0f }, { 0x3a15, 0xff },
+	{ 0x4001, 0x02 }, { 0x4004, 0x02 }, { 0x4713, 0x02 },
+	{ 0x4407, 0x04 }, { 0x460b, 0x37 }, { 0x460c, 0x20 },
+	{ 0x3824, 0x04 }, { 0x5001, 0xa3 }, { 0x4005, 0x1a },
+	{ 0x3008, 0x02 }, { 0x3503, 0 },
+	{ 0x5688, 0x11 },	// [START] Sigma exposure weights (161130)
+	{ 0x5689, 0x11 },	// keep 0x11 for HFOV28 and HFOV39
+	{ 0x568a, 0x11 },	//
+	{ 0x568b, 0x11 },	//
+	{ 0x568c, 0x11 },	//
+	{ 0x568d, 0x11 },	//
+	{ 0x568e, 0x11 },	//
+	{ 0x568f, 0x11 },	// [END] Sigma exposure weights (161130)
+	{ 0x5186, 0x10 },	// [START] Sigma HFOV39 AWB (161202)
+	{ 0x5187, 0x14 },	//
+	{ 0x5188, 0x10 },	//
+	{ 0x5189, 0x7d },	//
+	{ 0x518a, 0x6b },	//
+	{ 0x518e, 0x3a },	//
+	{ 0x518f, 0x4d },	//
+	{ 0x5190, 0x47 },	//
+	{ 0x5198, 0x04 },	//
+	{ 0x5199, 0x4d },	//
+	{ 0x519c, 0x08 },	//
+	{ 0x519d, 0x82 },	// [END] Sigma HFOV39 AWB (161202)
+};
+
+/*
+ *
+ *
+ * settings based on ov5640_setting_30fps_720P_1280_720
+ *
+ * mode timings from https://confluence-se.flir.net/display/IN/vcam+modes
+ *
+ * vcam fov=28 used with IR lens fov=12
+ *
+ */
+static const struct regc_op ov5640_setting_30fps_1280_960_HFOV28[] = {
+	{ 0x3008, 0x42 },
+	{ 0x3035, 0x21 }, { 0x3036, 0x5c }, { 0x3c07, 0x07 },
+	{ 0x3c09, 0x1c }, { 0x3c0a, 0x9c }, { 0x3c0b, 0x40 },
+	{ 0x3814, 0x11 },	//Horizontal subsamble increment
+	{ 0x3815, 0x11 },	//Vertical   subsamble increment
+	{ 0x3800, 0x02 }, { 0x3801, 0x90 },	//X address start = 0x290
+	{ 0x3802, 0x01 }, { 0x3803, 0xec },	//Y address start = 0x1ec
+	{ 0x3804, 0x07 }, { 0x3805, 0xaf },	//X address end   = 0x7af
+	{ 0x3806, 0x05 }, { 0x3807, 0xb3 },	//Y address end   = 0x5b3
+	{ 0x3808, 0x05 }, { 0x3809, 0x00 },	//DVP width  output size = 0x500   (1280)
+	{ 0x380a, 0x03 }, { 0x380b, 0xc0 },	//DVP height output size = 0x3c0   (960)
+	{ 0x380c, 0x06 }, { 0x380d, 0x00 },	// Total horizontal size = 0x600   (1536)
+	{ 0x380e, 0x03 }, { 0x380f, 0xd8 },	// Total vertical size  =  0x3d8   (984)
+	{ 0x3810, 0x00 }, { 0x3811, 0x10 },	// ISP horizontal offset = 0x10
+	{ 0x3812, 0x00 }, { 0x3813, 0x04 },	// ISP vertical   offset = 0x4
+	{ 0x3618, 0x00 }, { 0x3612, 0x29 }, { 0x3708, 0x64 },
+	{ 0x3709, 0x52 }, { 0x370c, 0x03 }, { 0x3a02, 0x0f },
+	{ 0x3a03, 0xff }, { 0x3a08, 0x01 }, { 0x3a09, 0xbc },
+	{ 0x3a0a, 0x01 }, { 0x3a0b, 0x72 }, { 0x3a0e, 0x06 },
+	{ 0x3a0d, 0x02 }, { 0x3a14, 0x0f }, { 0x3a15, 0xff },
+	{ 0x4001, 0x02 }, { 0x4004, 0x02 }, { 0x4713, 0x02 },
+	{ 0x4407, 0x04 }, { 0x460b, 0x37 }, { 0x460c, 0x20 },
+	{ 0x3824, 0x04 }, { 0x5001, 0x83 }, { 0x4005, 0x1a },
+	{ 0x3008, 0x02 }, { 0x3503, 0 },
+	{ 0x5688, 0x33 },	// [START] Sigma exposure weights (161130)
+	{ 0x5689, 0x33 },	// Tuned for HFOV54
+	{ 0x568a, 0x53 },	//
+	{ 0x568b, 0x35 },	//
+	{ 0x568c, 0x53 },	//
+	{ 0x568d, 0x35 },	//
+	{ 0x568e, 0x33 },	//
+	{ 0x568f, 0x33 },	// [END] Sigma exposure weights (161130)
+	{ 0x5186, 0x0b },	// [START] Sigma HFOV54/HFOV28 AWB (161202)
+	{ 0x5187, 0x0f },	//
+	{ 0x5188, 0x0c },	//
+	{ 0x5189, 0x72 },	//
+	{ 0x518a, 0x63 },	//
+	{ 0x518e, 0x3c },	//
+	{ 0x518f, 0x48 },	//
+	{ 0x5190, 0x45 },	//
+	{ 0x5198, 0x06 },	//
+	{ 0x5199, 0x9b },	//
+	{ 0x519c, 0x04 },	//
+	{ 0x519d, 0x14 },	// [END] Sigma HFOV54/HFOV28 AWB (161202)
+};
+
+/* OV5640 Configurations copied from WINCE Gas Camera */
+/*
+ * General initialization executed once at power on
+ *
+ *
+ */
+static const struct regc_op ov5640_init_interface_csi[] = {
+	{0x3103, 0x11}, //SCCB system control
+	{0x3008, 0x42}, //System root divider
+	{0x3103, 0x03}, //SCCB system control
+	{0x3017, 0xff}, //VSYNC I/O control
+	{0x3018, 0xff}, //Pad output enable
+	{0x3034, 0x1a}, //SC PLL control
+	{0x3035, 0x21}, //System clock divider
+	{0x3037, 0x13}, //PLL pre-divider
+	{0x3108, 0x01}, //System root divider
+	{0x302d, 0x60}, //System control
+
+	{0x3630, 0x36}, {0x3631, 0x0e}, //undoc start
+	{0x3632, 0xe2}, {0x3633, 0x12},
+	{0x3621, 0xe0}, {0x3704, 0xa0},
+	{0x3703, 0x5a}, {0x3715, 0x78},
+	{0x3717, 0x01}, {0x370b, 0x60},
+	{0x3705, 0x1a}, {0x3905, 0x02},
+	{0x3906, 0x10}, {0x3901, 0x0a},
+	{0x3731, 0x12}, {0x3620, 0x52},
+	{0x371b, 0x20}, {0x3635, 0x13},
+	{0x3636, 0x03}, {0x3634, 0x40},
+	{0x3622, 0x01}, {0x471c, 0x50},
+	{0x4050, 0x6e}, {0x4051, 0x8f},
+	{0x302e, 0x00}, {0x5025, 0x00},
+
+	{0x3824, 0x06}, //[AW change 02 to 06] PCLK divider
+	{0x3a13, 0x43}, //AEC ctrl
+	{0x3a18, 0x00}, {0x3a19, 0xf8}, //AEC Gain ceiling
+
+	{0x3c01, 0x34}, {0x3c05, 0x98}, //5060HZ ctrl
+	{0x3c06, 0x00}, {0x3c08, 0x00},
+	{0x3c09, 0x1c}, {0x3c0a, 0x9c},
+	{0x3c0b, 0x40},
+
+	{0x3820, 0x47}, //VFLIP
+	{0x3a08, 0x01}, {0x3a09, 0x27}, //AEC B50 step
+	{0x3a0a, 0x00}, {0x3a0b, 0xf6},
+	{0x4001, 0x02}, {0x4004, 0x02}, //BLC ctrl
+
+	{0x300e, 0x58}, //MIPI ctrl
+	{0x4300, 0x32}, //YUV422, YUYV
+	{0x501f, 0x00}, //ISP YUV422
+	{0x4713, 0x02}, //Jpeg mode 2
+	{0x4407, 0x04}, {0x440e, 0x00}, //JPG ctrl
+	{0x460b, 0x35}, //Debug
+	{0x460c, 0x22}, //DVP PCLK divider control by 0x3824
+	{0x471d, 0x00}, //[EVAL 01] VSYNC_mode according to FPGA
+	{0x4740, 0x21}, //[EVAL 20] VSYNC active high, HREF active low
+	{0x5000, 0xa7}, //ISP ctrl
+	{0x5180, 0xff}, {0x5181, 0xf2}, //AWB
+	{0x5182, 0x00}, {0x5183, 0x14},
+	{0x5184, 0x25}, {0x5185, 0x24},
+	{0x5186, 0x09}, {0x5187, 0x09},
+	{0x5188, 0x09}, {0x5189, 0x75},
+	{0x518a, 0x54}, {0x518b, 0xe0},
+	{0x518c, 0xb2}, {0x518d, 0x42},
+	{0x518e, 0x3d}, {0x518f, 0x56},
+	{0x5190, 0x46}, {0x5191, 0xf8},
+	{0x5192, 0x04}, {0x5193, 0x70},
+	{0x5194, 0xf0}, {0x5195, 0xf0},
+	{0x5196, 0x03}, {0x5197, 0x01},
+	{0x5198, 0x04}, {0x5199, 0x12},
+	{0x519a, 0x04}, {0x519b, 0x00},
+	{0x519c, 0x06}, {0x519d, 0x82},
+	{0x519e, 0x38},
+
+	{0x5381, 0x1e}, {0x5382, 0x5b}, //CMX
+	{0x5383, 0x08}, {0x5384, 0x0a},
+	{0x5385, 0x7e}, {0x5386, 0x88},
+	{0x5387, 0x7c}, {0x5388, 0x6c},
+	{0x5389, 0x10}, {0x538a, 0x01},
+	{0x538b, 0x98},
+
+	{0x5300, 0x08}, {0x5301, 0x30}, //CIP
+	{0x5302, 0x10}, {0x5303, 0x00},
+	{0x5304, 0x08}, {0x5305, 0x30},
+	{0x5306, 0x08}, {0x5307, 0x16},
+	{0x5309, 0x08}, {0x530a, 0x30},
+	{0x530b, 0x04}, {0x530c, 0x06},
+
+	{0x5480, 0x01}, {0x5481, 0x08}, //Gamma
+	{0x5482, 0x14}, {0x5483, 0x28},
+	{0x5484, 0x51}, {0x5485, 0x65},
+	{0x5486, 0x71}, {0x5487, 0x7d},
+	{0x5488, 0x87}, {0x5489, 0x91},
+	{0x548a, 0x9a}, {0x548b, 0xaa},
+	{0x548c, 0xb8}, {0x548d, 0xcd},
+	{0x548e, 0xdd}, {0x548f, 0xea},
+	{0x5490, 0x1d},
+
+	{0x5580, 0x02}, {0x5583, 0x40}, //SDE
+	{0x5584, 0x10}, {0x5589, 0x10},
+	{0x558a, 0x00}, {0x558b, 0xf8},
+
+	{0x5800, 0x3f}, {0x5801, 0x21}, //LENC
+	{0x5802, 0x13}, {0x5803, 0x11},
+	{0x5804, 0x1a}, {0x5805, 0x29},
+	{0x5806, 0x19}, {0x5807, 0x0c},
+	{0x5808, 0x06}, {0x5809, 0x04},
+	{0x580a, 0x08}, {0x580b, 0x18},
+	{0x580c, 0x12}, {0x580d, 0x06},
+	{0x580e, 0x01}, {0x580f, 0x00},
+	{0x5810, 0x04}, {0x5811, 0x0e},
+	{0x5812, 0x13}, {0x5813, 0x07},
+	{0x5814, 0x01}, {0x5815, 0x01},
+	{0x5816, 0x05}, {0x5817, 0x11},
+	{0x5818, 0x1e}, {0x5819, 0x10},
+	{0x581a, 0x0a}, {0x581b, 0x09},
+	{0x581c, 0x0f}, {0x581d, 0x1d},
+	{0x581e, 0x3f}, {0x581f, 0x2d},
+	{0x5820, 0x1e}, {0x5821, 0x1f},
+	{0x5822, 0x29}, {0x5823, 0x3f},
+	{0x5824, 0x16}, {0x5825, 0x18},
+	{0x5826, 0x09}, {0x5827, 0x17},
+	{0x5828, 0x1a}, {0x5829, 0x29},
+	{0x582a, 0x27}, {0x582b, 0x25},
+	{0x582c, 0x27}, {0x582d, 0x17},
+	{0x582e, 0x19}, {0x582f, 0x43},
+	{0x5830, 0x50}, {0x5831, 0x32},
+	{0x5832, 0x29}, {0x5833, 0x2b},
+	{0x5834, 0x38}, {0x5835, 0x36},
+	{0x5836, 0x27}, {0x5837, 0x28},
+	{0x5838, 0x28}, {0x5839, 0x2a},
+	{0x583a, 0x1e}, {0x583b, 0x2a},
+	{0x583c, 0x47}, {0x583d, 0xce},
+
+	{0x3a0f, 0x30}, {0x3a10, 0x28}, //AEC/AGC control start
+	{0x3a1b, 0x30}, {0x3a1e, 0x26},
+	{0x3a11, 0x60}, {0x3a1f, 0x14},
+
+	{0x5001, 0xa3}, //ISP ctrl, Scale enable
+	{0x3008, 0x02}, //Enable PCLK
+};
+
+#define REGC_PROGRAMS(X) \
+	X(ov5640_setting_High_K) \
+	X(ov5640_init_setting_9fps_5MP) \
+	X(ov5640_setting_15fps_5MP) \
+	X(ov5640_setting_dvp_draft) \
+	X(ov5640_setting_dvp_15fps_HFOV39) \
+	X(ov5640_setting_dvp_8fps_5MP) \
+	X(ov5640_setting_raw8) \
+	X(ov5640_setting_raw10) \
+	X(ov5640_setting_yuv422) \
+	X(ov5640_setting_30fps_1280_960_HFOV54) \
+	X(ov5640_setting_30fps_1280_960_HFOV39) \
+	X(ov5640_setting_30fps_1280_960_HFOV28) \
+	X(ov5640_init_interface_csi)
+
+#endif /* OV5640_TABLES_H */
@@ -0,0 +1,525 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *   V4L2 subdevice front-end for the OV5640 visual camera. The subdevice
+ *   is registered next to /dev/vcam0 and maps the V4L2 pad, video and
+ *   control operations onto the existing mode tables.
+ *
+ * Copyright: FLIR Systems AB
+ ***********************************************************************/
+
+#include "flir_kernel_os.h"
+#include "vcam_internal.h"
+#include <linux/platform_device.h>
+#include <media/v4l2-ctrls.h>
+#include <media/v4l2-device.h>
+#include <media/v4l2-subdev.h>
+#include "ov5640.h"
+
+/* driver private control, integer menu of the draft FOVs */
+#define V4L2_CID_VCAM_FOV	(V4L2_CID_USER_BASE | 0x1001)
+
+struct ov5640_v4l2 {
+	struct device *dev;
+	struct v4l2_device v4l2_dev;
+	struct v4l2_subdev sd;
+	struct media_pad pad;
+	struct v4l2_ctrl_handler ctrls;
+	struct {
+		/* exposure cluster, written in one group hold */
+		struct v4l2_ctrl *auto_exp;
+		struct v4l2_ctrl *exposure;
+		struct v4l2_ctrl *gain;
+	};
+	struct {
+		/* flip cluster */
+		struct v4l2_ctrl *hflip;
+		struct v4l2_ctrl *vflip;
+	};
+	struct v4l2_ctrl *test_pattern;
+	struct v4l2_ctrl *fov;
+};
+
+struct ov5640_v4l2_mode {
+	VCAM_Cam_Mode cam_mode;
+	u32 width;
+	u32 height;
+};
+
+static const struct ov5640_v4l2_mode ov5640_v4l2_modes[] = {
+	{ VCAM_DRAFT, 1280, 960 },
+	{ VCAM_STILL, 2592, 1944 },
+};
+
+static const char * const ov5640_test_pattern_menu[] = {
+	"Disabled",
+	"Color Bars",
+	"Ant Wars",
+};
+
+/* register 0x503d value of each test pattern menu entry */
+static const u8 ov5640_test_pattern_val[] = { 0x00, 0x80, 0x81 };
+
+static const s64 ov5640_fov_menu[] = { 54, 39, 28 };
+
+static inline struct ov5640_v4l2 *to_ov5640_v4l2(struct v4l2_subdev *sd)
+{
+	return container_of(sd, struct ov5640_v4l2, sd);
+}
+
+static const struct ov5640_v4l2_mode *ov5640_v4l2_current_mode(struct vcam_data *data)
+{
+	if (data->cam_mode == VCAM_STILL)
+		return &ov5640_v4l2_modes[1];
+	return &ov5640_v4l2_modes[0];
+}
+
+/* frame rate of a mode on this interface, draft at the current FOV */
+static u32 ov5640_v4l2_fps(struct device *dev, const struct ov5640_v4l2_mode *mode)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+
+	return ov5640_mode_fps(dev, mode->cam_mode == VCAM_STILL ? 0 : data->fov);
+}
+
+/* bus format of a mode, from the output format set with IOCTL_CAM_SET_FORMAT.
+ * YUV422 is 0x4300 = 0x32 in the mode programs, YUYV, sent as 16 bit
+ * samples on MIPI. RAW is the BGGR order of ov5640_setting_raw8/10.
+ */
+static u32 ov5640_v4l2_code(struct vcam_data *data, const struct ov5640_v4l2_mode *mode)
+{
+	VCAM_OutputFormat fmt = mode->cam_mode == VCAM_STILL ?
+		data->out_format.eStillFormat : data->out_format.eDraftFormat;
+
+	if (fmt == VCAM_FMT_RAW8)
+		return MEDIA_BUS_FMT_SBGGR8_1X8;
+	if (fmt == VCAM_FMT_RAW10)
+		return MEDIA_BUS_FMT_SBGGR10_1X10;
+	if (data->profile.parallel_interface)
+		return MEDIA_BUS_FMT_YUYV8_2X8;
+	return MEDIA_BUS_FMT_YUYV8_1X16;
+}
+
+static int ov5640_fov_index(int fov)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ov5640_fov_menu); i++)
+		if (ov5640_fov_menu[i] == fov)
+			return i;
+	return 0;
+}
+
+/* controls */
+
+static int ov5640_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct ov5640_v4l2 *sensor = container_of(ctrl->handler, struct ov5640_v4l2, ctrls);
+	struct vcam_data *data = dev_get_drvdata(sensor->dev);
+	u32 exposure;
+	u16 gain;
+	int ret = 0;
+
+	switch (ctrl->id) {
+	case V4L2_CID_EXPOSURE_AUTO:
+		if (down_interruptible(&data->sem))
+			return -ERESTARTSYS;
+		ret = ov5640_get_exposure_gain(sensor->dev, &exposure, &gain);
+		up(&data->sem);
+		if (ret)
+			return ret;
+		sensor->exposure->val = exposure >> 4;
+		sensor->gain->val = gain;
+		break;
+	case V4L2_CID_HFLIP:
+		sensor->hflip->val = data->mirror;
+		sensor->vflip->val = data->flip;
+		break;
+	case V4L2_CID_VCAM_FOV:
+		ctrl->val = ov5640_fov_index(data->fov);
+		break;
+	}
+
+	return ret;
+}
+
+static int ov5640_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct ov5640_v4l2 *sensor = container_of(ctrl->handler, struct ov5640_v4l2, ctrls);
+	struct device *dev = sensor->dev;
+	struct vcam_data *data = dev_get_drvdata(dev);
+	VCAMIOCTLFOV fov;
+	int ret;
+
+	/* FOV changes take the same path as IOCTL_CAM_SET_FOV */
+	if (ctrl->id == V4L2_CID_VCAM_FOV) {
+		fov.fov = ov5640_fov_menu[ctrl->val];
+		return ov5640_ioctl(dev, IOCTL_CAM_SET_FOV, (PUCHAR)&fov, NULL);
+	}
+
+	if (down_interruptible(&data->sem))
+		return -ERESTARTSYS;
+
+	/* clustered controls arrive here once, through the cluster master */
+	switch (ctrl->id) {
+	case V4L2_CID_EXPOSURE_AUTO:
+		ret = ov5640_set_exposure_gain(dev, sensor->auto_exp->val == V4L2_EXPOSURE_AUTO,
+					       sensor->exposure->val << 4, sensor->gain->val);
+		break;
+	case V4L2_CID_HFLIP:
+		ret = ov5640_set_flip_mirror(dev, sensor->vflip->val, sensor->hflip->val);
+		break;
+	case V4L2_CID_TEST_PATTERN:
+		ret = ov5640_testpattern_enable(dev, ov5640_test_pattern_val[ctrl->val]);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	up(&data->sem);
+	return ret;
+}
+
+static const struct v4l2_ctrl_ops ov5640_ctrl_ops = {
+	.g_volatile_ctrl = ov5640_g_volatile_ctrl,
+	.s_ctrl = ov5640_s_ctrl,
+};
+
+static const struct v4l2_ctrl_config ov5640_fov_ctrl = {
+	.ops = &ov5640_ctrl_ops,
+	.id = V4L2_CID_VCAM_FOV,
+	.name = "Field of View",
+	.type = V4L2_CTRL_TYPE_INTEGER_MENU,
+	.max = ARRAY_SIZE(ov5640_fov_menu) - 1,
+	.qmenu_int = ov5640_fov_menu,
+	.flags = V4L2_CTRL_FLAG_VOLATILE | V4L2_CTRL_FLAG_EXECUTE_ON_WRITE,
+};
+
+/* video ops */
+
+static int ov5640_s_stream(struct v4l2_subdev *sd, int enable)
+{
+	struct ov5640_v4l2 *sensor = to_ov5640_v4l2(sd);
+	struct vcam_data *data = dev_get_drvdata(sensor->dev);
+	int ret;
+
+	if (down_interruptible(&data->sem))
+		return -ERESTARTSYS;
+	ret = ov5640_enable_stream(sensor->dev, enable);
+	up(&data->sem);
+
+	return ret;
+}
+
+static int ov5640_g_frame_interval(struct v4l2_subdev *sd, struct v4l2_subdev_frame_interval *fi)
+{
+	struct ov5640_v4l2 *sensor = to_ov5640_v4l2(sd);
+	struct vcam_data *data = dev_get_drvdata(sensor->dev);
+
+	fi->interval.numerator = 1;
+	fi->interval.denominator = ov5640_v4l2_fps(sensor->dev, ov5640_v4l2_current_mode(data));
+	return 0;
+}
+
+/* The frame rate is fixed per mode, report the rate of the current one */
+static int ov5640_s_frame_interval(struct v4l2_subdev *sd, struct v4l2_subdev_frame_interval *fi)
+{
+	return ov5640_g_frame_interval(sd, fi);
+}
+
+/* pad ops */
+
+static void ov5640_fill_fmt(u32 code, const struct ov5640_v4l2_mode *mode,
+			    struct v4l2_mbus_framefmt *fmt)
+{
+	fmt->code = code;
+	fmt->width = mode->width;
+	fmt->height = mode->height;
+	fmt->field = V4L2_FIELD_NONE;
+	if (code == MEDIA_BUS_FMT_SBGGR8_1X8 || code == MEDIA_BUS_FMT_SBGGR10_1X10)
+		fmt->colorspace = V4L2_COLORSPACE_RAW;
+	else
+		fmt->colorspace = V4L2_COLORSPACE_SRGB;
+	fmt->ycbcr_enc = V4L2_YCBCR_ENC_DEFAULT;
+	fmt->quantization = V4L2_QUANTIZATION_FULL_RANGE;
+	fmt->xfer_func = V4L2_XFER_FUNC_DEFAULT;
+}
+
+static int ov5640_init_cfg(struct v4l2_subdev *sd, struct v4l2_subdev_state *state)
+{
+	struct ov5640_v4l2 *sensor = to_ov5640_v4l2(sd);
+	struct vcam_data *data = dev_get_drvdata(sensor->dev);
+
+	ov5640_fill_fmt(ov5640_v4l2_code(data, &ov5640_v4l2_modes[0]), &ov5640_v4l2_modes[0],
+			v4l2_subdev_get_try_format(sd, state, 0));
+	return 0;
+}
+
+static int ov5640_enum_mbus_code(struct v4l2_subdev *sd, struct v4l2_subdev_state *state,
+				 struct v4l2_subdev_mbus_code_enum *code)
+{
+	struct ov5640_v4l2 *sensor = to_ov5640_v4l2(sd);
+	struct vcam_data *data = dev_get_drvdata(sensor->dev);
+
+	if (code->pad || code->index)
+		return -EINVAL;
+
+	code->code = ov5640_v4l2_code(data, ov5640_v4l2_current_mode(data));
+	return 0;
+}
+
+static int ov5640_enum_frame_size(struct v4l2_subdev *sd, struct v4l2_subdev_state *state,
+				  struct v4l2_subdev_frame_size_enum *fse)
+{
+	struct ov5640_v4l2 *sensor = to_ov5640_v4l2(sd);
+	struct vcam_data *data = dev_get_drvdata(sensor->dev);
+	unsigned int index = fse->index;
+	int i;
+
+	if (fse->pad)
+		return -EINVAL;
+
+	/* the modes may differ in format, enumerate those with fse->code */
+	for (i = 0; i < ARRAY_SIZE(ov5640_v4l2_modes); i++) {
+		if (fse->code != ov5640_v4l2_code(data, &ov5640_v4l2_modes[i]) || index--)
+			continue;
+		fse->min_width = fse->max_width = ov5640_v4l2_modes[i].width;
+		fse->min_height = fse->max_height = ov5640_v4l2_modes[i].height;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+static int ov5640_enum_frame_interval(struct v4l2_subdev *sd, struct v4l2_subdev_state *state,
+				      struct v4l2_subdev_frame_interval_enum *fie)
+{
+	struct ov5640_v4l2 *sensor = to_ov5640_v4l2(sd);
+	struct vcam_data *data = dev_get_drvdata(sensor->dev);
+	int i;
+
+	if (fie->pad || fie->index)
+		return -EINVAL;
+
+	for (i = 0; i < ARRAY_SIZE(ov5640_v4l2_modes); i++) {
+		if (fie->code == ov5640_v4l2_code(data, &ov5640_v4l2_modes[i]) &&
+		    ov5640_v4l2_modes[i].width == fie->width &&
+		    ov5640_v4l2_modes[i].height == fie->height) {
+			fie->interval.numerator = 1;
+			fie->interval.denominator = ov5640_v4l2_fps(sensor->dev, &ov5640_v4l2_modes[i]);
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static int ov5640_get_fmt(struct v4l2_subdev *sd, struct v4l2_subdev_state *state,
+			  struct v4l2_subdev_format *format)
+{
+	struct ov5640_v4l2 *sensor = to_ov5640_v4l2(sd);
+	struct vcam_data *data = dev_get_drvdata(sensor->dev);
+
+	if (format->pad)
+		return -EINVAL;
+
+	if (format->which == V4L2_SUBDEV_FORMAT_TRY)
+		format->format = *v4l2_subdev_get_try_format(sd, state, 0);
+	else
+		ov5640_fill_fmt(ov5640_v4l2_code(data, ov5640_v4l2_current_mode(data)),
+				ov5640_v4l2_current_mode(data), &format->format);
+
+	return 0;
+}
+
+/* ov5640_set_fmt
+ *
+ * 2592x1944 selects the still mode, any other size the draft mode at
+ * the current FOV.
+ */
+static int ov5640_set_fmt(struct v4l2_subdev *sd, struct v4l2_subdev_state *state,
+			  struct v4l2_subdev_format *format)
+{
+	struct ov5640_v4l2 *sensor = to_ov5640_v4l2(sd);
+	struct vcam_data *data = dev_get_drvdata(sensor->dev);
+	const struct ov5640_v4l2_mode *mode = &ov5640_v4l2_modes[0];
+	VCAMIOCTLCAMMODE cam_mode;
+	int ret;
+
+	if (format->pad)
+		return -EINVAL;
+
+	if (format->format.width == ov5640_v4l2_modes[1].width &&
+	    format->format.height == ov5640_v4l2_modes[1].height)
+		mode = &ov5640_v4l2_modes[1];
+
+	ov5640_fill_fmt(ov5640_v4l2_code(data, mode), mode, &format->format);
+
+	if (format->which == V4L2_SUBDEV_FORMAT_TRY) {
+		*v4l2_subdev_get_try_format(sd, state, 0) = format->format;
+		return 0;
+	}
+
+	if (mode == ov5640_v4l2_current_mode(data) && data->cam_mode != VCAM_UNDEFINED)
+		return 0;
+
+	cam_mode.eCamMode = mode->cam_mode;
+	ret = ov5640_ioctl(sensor->dev, IOCTL_CAM_SET_CAMMODE, (PUCHAR)&cam_mode, NULL);
+	return ret ? -EIO : 0;
+}
+
+static const struct v4l2_subdev_video_ops ov5640_video_ops = {
+	.s_stream = ov5640_s_stream,
+	.g_frame_interval = ov5640_g_frame_interval,
+	.s_frame_interval = ov5640_s_frame_interval,
+};
+
+static const struct v4l2_subdev_pad_ops ov5640_pad_ops = {
+	.init_cfg = ov5640_init_cfg,
+	.enum_mbus_code = ov5640_enum_mbus_code,
+	.enum_frame_size = ov5640_enum_frame_size,
+	.enum_frame_interval = ov5640_enum_frame_interval,
+	.get_fmt = ov5640_get_fmt,
+	.set_fmt = ov5640_set_fmt,
+};
+
+static const struct v4l2_subdev_ops ov5640_subdev_ops = {
+	.video = &ov5640_video_ops,
+	.pad = &ov5640_pad_ops,
+};
+
+/* ov5640_init_controls
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int ov5640_init_controls(struct ov5640_v4l2 *sensor)
+{
+	struct vcam_data *data = dev_get_drvdata(sensor->dev);
+	struct v4l2_ctrl_handler *hdl = &sensor->ctrls;
+	const struct v4l2_ctrl_ops *ops = &ov5640_ctrl_ops;
+	struct v4l2_ctrl_config fov_cfg = ov5640_fov_ctrl;
+
+	v4l2_ctrl_handler_init(hdl, 7);
+
+	sensor->auto_exp = v4l2_ctrl_new_std_menu(hdl, ops, V4L2_CID_EXPOSURE_AUTO,
+						  V4L2_EXPOSURE_MANUAL, 0, V4L2_EXPOSURE_AUTO);
+	/* exposure in lines, gain in 1/16 steps */
+	sensor->exposure = v4l2_ctrl_new_std(hdl, ops, V4L2_CID_EXPOSURE, 1, 0xffff, 1, 0x3d0);
+	sensor->gain = v4l2_ctrl_new_std(hdl, ops, V4L2_CID_GAIN, 0, 0x3ff, 1, 0x10);
+
+	sensor->hflip = v4l2_ctrl_new_std(hdl, ops, V4L2_CID_HFLIP, 0, 1, 1, data->mirror);
+	sensor->vflip = v4l2_ctrl_new_std(hdl, ops, V4L2_CID_VFLIP, 0, 1, 1, data->flip);
+
+	sensor->test_pattern = v4l2_ctrl_new_std_menu_items(hdl, ops, V4L2_CID_TEST_PATTERN,
+							    ARRAY_SIZE(ov5640_test_pattern_menu) - 1,
+							    0, 0, ov5640_test_pattern_menu);
+
+	fov_cfg.def = ov5640_fov_index(data->fov);
+	sensor->fov = v4l2_ctrl_new_custom(hdl, &fov_cfg, NULL);
+
+	if (hdl->error) {
+		int ret = hdl->error;
+
+		v4l2_ctrl_handler_free(hdl);
+		return ret;
+	}
+
+	/* flip state is also changed through /dev/vcam0, always read and write it */
+	sensor->hflip->flags |= V4L2_CTRL_FLAG_VOLATILE | V4L2_CTRL_FLAG_EXECUTE_ON_WRITE;
+	sensor->vflip->flags |= V4L2_CTRL_FLAG_VOLATILE | V4L2_CTRL_FLAG_EXECUTE_ON_WRITE;
+
+	v4l2_ctrl_auto_cluster(3, &sensor->auto_exp, V4L2_EXPOSURE_MANUAL, true);
+	v4l2_ctrl_cluster(2, &sensor->hflip);
+
+	sensor->sd.ctrl_handler = hdl;
+	return 0;
+}
+
+/* ov5640_v4l2_register
+ *
+ * Register the sensor as a V4L2 subdevice with its own device node.
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+int ov5640_v4l2_register(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct ov5640_v4l2 *sensor;
+	int ret;
+
+	sensor = devm_kzalloc(dev, sizeof(*sensor), GFP_KERNEL);
+	if (!sensor)
+		return -ENOMEM;
+
+	sensor->dev = dev;
+
+	ret = v4l2_device_register(dev, &sensor->v4l2_dev);
+	if (ret) {
+		dev_err(dev, "Failed to register v4l2 device (%i)\n", ret);
+		return ret;
+	}
+
+	v4l2_subdev_init(&sensor->sd, &ov5640_subdev_ops);
+	snprintf(sensor->sd.name, sizeof(sensor->sd.name), "ov5640 %s", dev_name(dev));
+	sensor->sd.owner = THIS_MODULE;
+	sensor->sd.dev = dev;
+	sensor->sd.flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
+
+	ret = ov5640_init_controls(sensor);
+	if (ret) {
+		dev_err(dev, "Failed to create controls (%i)\n", ret);
+		goto err_v4l2_dev;
+	}
+
+	sensor->pad.flags = MEDIA_PAD_FL_SOURCE;
+	sensor->sd.entity.function = MEDIA_ENT_F_CAM_SENSOR;
+	ret = media_entity_pads_init(&sensor->sd.entity, 1, &sensor->pad);
+	if (ret)
+		goto err_ctrls;
+
+	ret = v4l2_device_register_subdev(&sensor->v4l2_dev, &sensor->sd);
+	if (ret) {
+		dev_err(dev, "Failed to register subdevice (%i)\n", ret);
+		goto err_entity;
+	}
+
+	ret = v4l2_device_register_subdev_nodes(&sensor->v4l2_dev);
+	if (ret) {
+		dev_err(dev, "Failed to register subdevice node (%i)\n", ret);
+		goto err_subdev;
+	}
+
+	data->v4l2 = sensor;
+	return 0;
+
+err_subdev:
+	v4l2_device_unregister_subdev(&sensor->sd);
+err_entity:
+	media_entity_cleanup(&sensor->sd.entity);
+err_ctrls:
+	v4l2_ctrl_handler_free(&sensor->ctrls);
+err_v4l2_dev:
+	v4l2_device_unregister(&sensor->v4l2_dev);
+	return ret;
+}
+
+void ov5640_v4l2_unregister(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct ov5640_v4l2 *sensor = data->v4l2;
+
+	if (!sensor)
+		return;
+
+	data->v4l2 = NULL;
+	v4l2_device_unregister_subdev(&sensor->sd);
+	media_entity_cleanup(&sensor->sd.entity);
+	v4l2_ctrl_handler_free(&sensor->ctrls);
+	v4l2_device_unregister(&sensor->v4l2_dev);
+}
@@ -0,0 +1,505 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/***********************************************************************
+ *
+ * Project: Balthazar
+ *
+ * Description of file:
+ *   Load and latency benchmark for the vcam driver. Runs mixes of
+ *   ioctl and sysfs operations from several threads against /dev/vcam0
+ *   and reports per command latency and throughput as CSV.
+ *
+ *   vcam_bench [-d dev] [-s sysfs dir] [-t seconds] [-o file] [-S] -w mix...
+ *
+ *   mix is name[:threads[:pause_us]], pause_us is the delay between
+ *   operations of one thread, e.g. a UI poller at 20 Hz is getters:1:50000
+ *
+ *   Every thread opens the device itself, like separate applications, so
+ *   the per open priority and request arbitration apply between them.
+ *   -S shares one open file between all threads instead.
+ *
+ *   getters  GET_CAMMODE, GET_FOV, GET_FOCUS, GET_STATS, GET_ACTIVE and
+ *            reads of fov, testpattern and vcam_eoco_power
+ *   fov      SET_FOV 54 -> 39 -> 28
+ *   still    SET_CAMMODE STILL, then DRAFT
+ *   grab     GRAB_STILL
+ *   suspend  SUSPEND, then RESUME
+ *   sysfs    writes of fov, flip, mirror_enable, testpattern and
+ *            enable_stream
+ *
+ * Copyright: FLIR Systems AB
+ ***********************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef int BOOL;
+#include "../vcam_ioctl.h"
+
+#define MAX_MIXES	16
+
+enum bench_cmd {
+	CMD_GET_CAMMODE,
+	CMD_GET_FOV,
+	CMD_GET_FOCUS,
+	CMD_GET_STATS,
+	CMD_GET_ACTIVE,
+	CMD_SET_FOV,
+	CMD_SET_STILL,
+	CMD_SET_DRAFT,
+	CMD_GRAB_STILL,
+	CMD_SUSPEND,
+	CMD_RESUME,
+	CMD_SYSFS_READ_FOV,
+	CMD_SYSFS_READ_TESTPATTERN,
+	CMD_SYSFS_READ_EOCO_POWER,
+	CMD_SYSFS_FOV,
+	CMD_SYSFS_FLIP,
+	CMD_SYSFS_MIRROR,
+	CMD_SYSFS_TESTPATTERN,
+	CMD_SYSFS_STREAM,
+	CMD_COUNT
+};
+
+static const char *const cmd_names[CMD_COUNT] = {
+	[CMD_GET_CAMMODE] = "ioctl_get_cammode",
+	[CMD_GET_FOV] = "ioctl_get_fov",
+	[CMD_GET_FOCUS] = "ioctl_get_focus",
+	[CMD_GET_STATS] = "ioctl_get_stats",
+	[CMD_GET_ACTIVE] = "ioctl_get_active",
+	[CMD_SET_FOV] = "ioctl_set_fov",
+	[CMD_SET_STILL] = "ioctl_set_cammode_still",
+	[CMD_SET_DRAFT] = "ioctl_set_cammode_draft",
+	[CMD_GRAB_STILL] = "ioctl_grab_still",
+	[CMD_SUSPEND] = "ioctl_suspend",
+	[CMD_RESUME] = "ioctl_resume",
+	[CMD_SYSFS_READ_FOV] = "sysfs_read_fov",
+	[CMD_SYSFS_READ_TESTPATTERN] = "sysfs_read_testpattern",
+	[CMD_SYSFS_READ_EOCO_POWER] = "sysfs_read_vcam_eoco_power",
+	[CMD_SYSFS_FOV] = "sysfs_write_fov",
+	[CMD_SYSFS_FLIP] = "sysfs_write_flip",
+	[CMD_SYSFS_MIRROR] = "sysfs_write_mirror_enable",
+	[CMD_SYSFS_TESTPATTERN] = "sysfs_write_testpattern",
+	[CMD_SYSFS_STREAM] = "sysfs_write_enable_stream",
+};
+
+/* latencies of one command in one thread, in ns */
+struct samples {
+	uint64_t *ns;
+	size_t n;
+	size_t cap;
+	unsigned long errors;
+};
+
+struct worker {
+	pthread_t thread;
+	const struct mix *mix;
+	int fd;			/* open of dev_path, shared with -S */
+	unsigned int pause_us;
+	unsigned int step;
+	struct samples samples[CMD_COUNT];
+};
+
+struct mix {
+	const char *name;
+	void (*step)(struct worker *w);
+};
+
+static const char *dev_path = "/dev/vcam0";
+static const char *sysfs_dir = "/sys/class/misc/vcam0/device";
+static volatile sig_atomic_t stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void record(struct worker *w, enum bench_cmd cmd, uint64_t start, int failed)
+{
+	struct samples *s = &w->samples[cmd];
+	uint64_t *ns;
+
+	if (failed)
+		s->errors++;
+
+	if (s->n == s->cap) {
+		s->cap = s->cap ? 2 * s->cap : 1024;
+		ns = realloc(s->ns, s->cap * sizeof(*ns));
+		if (!ns) {
+			perror("realloc");
+			exit(1);
+		}
+		s->ns = ns;
+	}
+	s->ns[s->n++] = now_ns() - start;
+}
+
+/* the driver returns positive ERROR_* codes besides negative errnos */
+static void do_ioctl(struct worker *w, enum bench_cmd cmd, unsigned long req, void *arg)
+{
+	uint64_t start = now_ns();
+	int ret;
+
+	ret = ioctl(w->fd, req, arg);
+	record(w, cmd, start, ret != 0);
+}
+
+static void sysfs_read(struct worker *w, enum bench_cmd cmd, const char *attr)
+{
+	char path[256], buf[64];
+	uint64_t start;
+	int fd, ret;
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs_dir, attr);
+	start = now_ns();
+	fd = open(path, O_RDONLY);
+	ret = fd < 0 ? -1 : (int)read(fd, buf, sizeof(buf));
+	if (fd >= 0)
+		close(fd);
+	record(w, cmd, start, ret < 0);
+}
+
+static void sysfs_write(struct worker *w, enum bench_cmd cmd, const char *attr, int val)
+{
+	char path[256], buf[16];
+	uint64_t start;
+	int fd, len, ret;
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs_dir, attr);
+	len = snprintf(buf, sizeof(buf), "%d", val);
+	start = now_ns();
+	fd = open(path, O_WRONLY);
+	ret = fd < 0 ? -1 : (int)write(fd, buf, len);
+	if (fd >= 0)
+		close(fd);
+	record(w, cmd, start, ret != len);
+}
+
+static const int fovs[] = { 54, 39, 28 };
+
+static void step_getters(struct worker *w)
+{
+	VCAMIOCTLCAMMODE mode;
+	VCAMIOCTLFOV fov;
+	VCAMIOCTLFOCUS focus;
+	VCAMIOCTLSTATS stats;
+	VCAMIOCTLACTIVE active;
+
+	switch (w->step++ % 8) {
+	case 0:
+		do_ioctl(w, CMD_GET_CAMMODE, IOCTL_CAM_GET_CAMMODE, &mode);
+		break;
+	case 1:
+		do_ioctl(w, CMD_GET_FOV, IOCTL_CAM_GET_FOV, &fov);
+		break;
+	case 2:
+		do_ioctl(w, CMD_GET_FOCUS, IOCTL_CAM_GET_FOCUS, &focus);
+		break;
+	case 3:
+		do_ioctl(w, CMD_GET_STATS, IOCTL_CAM_GET_STATS, &stats);
+		break;
+	case 4:
+		do_ioctl(w, CMD_GET_ACTIVE, IOCTL_CAM_GET_ACTIVE, &active);
+		break;
+	case 5:
+		sysfs_read(w, CMD_SYSFS_READ_FOV, "fov");
+		break;
+	case 6:
+		sysfs_read(w, CMD_SYSFS_READ_TESTPATTERN, "testpattern");
+		break;
+	case 7:
+		sysfs_read(w, CMD_SYSFS_READ_EOCO_POWER, "vcam_eoco_power");
+		break;
+	}
+}
+
+static void step_fov(struct worker *w)
+{
+	VCAMIOCTLFOV fov = { .fov = fovs[w->step++ % 3] };
+
+	do_ioctl(w, CMD_SET_FOV, IOCTL_CAM_SET_FOV, &fov);
+}
+
+static void step_still(struct worker *w)
+{
+	VCAMIOCTLCAMMODE mode;
+
+	if (w->step++ & 1) {
+		mode.eCamMode = VCAM_DRAFT;
+		do_ioctl(w, CMD_SET_DRAFT, IOCTL_CAM_SET_CAMMODE, &mode);
+	} else {
+		mode.eCamMode = VCAM_STILL;
+		do_ioctl(w, CMD_SET_STILL, IOCTL_CAM_SET_CAMMODE, &mode);
+	}
+}
+
+static void step_grab(struct worker *w)
+{
+	do_ioctl(w, CMD_GRAB_STILL, IOCTL_CAM_GRAB_STILL, NULL);
+}
+
+static void step_suspend(struct worker *w)
+{
+	if (w->step++ & 1)
+		do_ioctl(w, CMD_RESUME, IOCTL_CAM_RESUME, NULL);
+	else
+		do_ioctl(w, CMD_SUSPEND, IOCTL_CAM_SUSPEND, NULL);
+}
+
+static void step_sysfs(struct worker *w)
+{
+	unsigned int n = w->step++;
+
+	switch (n % 5) {
+	case 0:
+		sysfs_write(w, CMD_SYSFS_FOV, "fov", fovs[(n / 5) % 3]);
+		break;
+	case 1:
+		sysfs_write(w, CMD_SYSFS_FLIP, "flip", (n / 5) & 1);
+		break;
+	case 2:
+		sysfs_write(w, CMD_SYSFS_MIRROR, "mirror_enable", (n / 5) & 1);
+		break;
+	case 3:
+		sysfs_write(w, CMD_SYSFS_TESTPATTERN, "testpattern", (n / 5) & 1);
+		break;
+	case 4:
+		sysfs_write(w, CMD_SYSFS_STREAM, "enable_stream", 1);
+		break;
+	}
+}
+
+static const struct mix mixes[] = {
+	{ "getters", step_getters },
+	{ "fov", step_fov },
+	{ "still", step_still },
+	{ "grab", step_grab },
+	{ "suspend", step_suspend },
+	{ "sysfs", step_sysfs },
+};
+
+static void *worker_run(void *arg)
+{
+	struct worker *w = arg;
+
+	while (!stop) {
+		w->mix->step(w);
+		if (w->pause_us)
+			usleep(w->pause_us);
+	}
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* nearest rank percentile of sorted samples */
+static uint64_t percentile(const uint64_t *ns, size_t n, unsigned int p)
+{
+	size_t rank = (n * p + 99) / 100;
+
+	return ns[rank ? rank - 1 : 0];
+}
+
+static void report(FILE *out, struct worker *workers, unsigned int nworkers, double seconds)
+{
+	struct samples all;
+	unsigned int cmd, i;
+
+	fprintf(out, "command,calls,errors,ops_per_s,p50_us,p99_us,max_us\n");
+
+	for (cmd = 0; cmd < CMD_COUNT; cmd++) {
+		memset(&all, 0, sizeof(all));
+		for (i = 0; i < nworkers; i++)
+			all.n += workers[i].samples[cmd].n;
+		if (!all.n)
+			continue;
+
+		all.ns = malloc(all.n * sizeof(*all.ns));
+		if (!all.ns) {
+			perror("malloc");
+			exit(1);
+		}
+		for (i = 0; i < nworkers; i++) {
+			struct samples *s = &workers[i].samples[cmd];
+
+			memcpy(all.ns + all.cap, s->ns, s->n * sizeof(*s->ns));
+			all.cap += s->n;
+			all.errors += s->errors;
+		}
+		qsort(all.ns, all.n, sizeof(*all.ns), cmp_u64);
+
+		fprintf(out, "%s,%zu,%lu,%.1f,%.1f,%.1f,%.1f\n", cmd_names[cmd], all.n,
+			all.errors, all.n / seconds,
+			percentile(all.ns, all.n, 50) / 1000.0,
+			percentile(all.ns, all.n, 99) / 1000.0,
+			all.ns[all.n - 1] / 1000.0);
+		free(all.ns);
+	}
+}
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static void usage(const char *prog)
+{
+	unsigned int i;
+
+	fprintf(stderr,
+		"usage: %s [-d dev] [-s sysfs dir] [-t seconds] [-o file] [-S] -w mix[:threads[:pause_us]]...\n"
+		"mixes:", prog);
+	for (i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i++)
+		fprintf(stderr, " %s", mixes[i].name);
+	fprintf(stderr, "\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct {
+		const struct mix *mix;
+		unsigned int threads;
+		unsigned int pause_us;
+	} spec[MAX_MIXES];
+	unsigned int nspec = 0, nworkers = 0, seconds = 10;
+	struct worker *workers;
+	const char *out_path = NULL;
+	struct sigaction sa;
+	uint64_t start, elapsed;
+	FILE *out = stdout;
+	unsigned int i, j;
+	char *name, *arg;
+	int shared_fd = -1;
+	int share = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:s:t:o:w:Sh")) != -1) {
+		switch (opt) {
+		case 'S':
+			share = 1;
+			break;
+		case 'd':
+			dev_path = optarg;
+			break;
+		case 's':
+			sysfs_dir = optarg;
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			out_path = optarg;
+			break;
+		case 'w':
+			if (nspec == MAX_MIXES)
+				usage(argv[0]);
+			name = strtok(optarg, ":");
+			spec[nspec].mix = NULL;
+			for (i = 0; name && i < sizeof(mixes) / sizeof(mixes[0]); i++)
+				if (!strcmp(name, mixes[i].name))
+					spec[nspec].mix = &mixes[i];
+			if (!spec[nspec].mix)
+				usage(argv[0]);
+			arg = strtok(NULL, ":");
+			spec[nspec].threads = arg ? strtoul(arg, NULL, 0) : 1;
+			arg = strtok(NULL, ":");
+			spec[nspec].pause_us = arg ? strtoul(arg, NULL, 0) : 0;
+			nworkers += spec[nspec].threads;
+			nspec++;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!nworkers || !seconds)
+		usage(argv[0]);
+
+	if (share) {
+		shared_fd = open(dev_path, O_RDWR);
+		if (shared_fd < 0) {
+			fprintf(stderr, "%s: %s\n", dev_path, strerror(errno));
+			return 1;
+		}
+	}
+
+	if (out_path) {
+		out = fopen(out_path, "w");
+		if (!out) {
+			fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+			return 1;
+		}
+	}
+
+	workers = calloc(nworkers, sizeof(*workers));
+	if (!workers) {
+		perror("calloc");
+		return 1;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	start = now_ns();
+	nworkers = 0;
+	for (i = 0; i < nspec && !stop; i++) {
+		for (j = 0; j < spec[i].threads; j++) {
+			struct worker *w = &workers[nworkers];
+
+			w->mix = spec[i].mix;
+			w->pause_us = spec[i].pause_us;
+			w->fd = share ? shared_fd : open(dev_path, O_RDWR);
+			if (w->fd < 0) {
+				fprintf(stderr, "%s: %s\n", dev_path, strerror(errno));
+				stop = 1;
+				break;
+			}
+			if (pthread_create(&w->thread, NULL, worker_run, w)) {
+				perror("pthread_create");
+				if (!share)
+					close(w->fd);
+				stop = 1;
+				break;
+			}
+			nworkers++;
+		}
+	}
+
+	for (i = 0; i < seconds && !stop; i++)
+		sleep(1);
+	stop = 1;
+
+	for (i = 0; i < nworkers; i++)
+		pthread_join(workers[i].thread, NULL);
+	elapsed = now_ns() - start;
+
+	report(out, workers, nworkers, elapsed / 1e9);
+
+	if (out != stdout)
+		fclose(out);
+	if (share)
+		close(shared_fd);
+	else
+		for (i = 0; i < nworkers; i++)
+			close(workers[i].fd);
+	return 0;
+}
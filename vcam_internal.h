@@ -14,12 +14,145 @@
 #include "vcam_ioctl.h"
 #include "flir_kernel_os.h"
 #include <linux/miscdevice.h>
+#include <linux/kthread.h>
+
+struct ov5640_v4l2;
+
+/* Definition of DT node name, construction is error prone, so avoiding some
+ * error possibilities by using definition
+ */
+#define VCAM_PARALLELL_INTERFACE "vcam_parallell_interface"
+
+enum vcam_gpio {
+	VCAM_GPIO_CLK_EN,
+	VCAM_GPIO_PWDN,
+	VCAM_GPIO_RESET,
+	VCAM_GPIO_COUNT
+};
+
+// board specific power sequencing and interface, resolved once at probe
+struct vcam_profile {
+	bool eoco;			// fsl,imx6qp-eoco board
+	bool parallel_interface;	// parallel (CSI) sensor interface, else MIPI
+	u32 mipi_max_mbps;		// MIPI receiver lane rate limit, 0 if not given
+	struct gpio_desc *gpios[VCAM_GPIO_COUNT];
+	unsigned long off_values;	// raw GPIO levels, bit per enum vcam_gpio
+	unsigned long clocked_values;	// clock running, out of power down, in reset
+	unsigned long on_values;
+};
 
 enum sensor_model {
 	OV5640_STANDARD,
 	OV5640_HIGH_K
 };
 
+// deferred sensor work, run on the per-device worker, see vcamd.c
+struct vcam_work {
+	struct kthread_delayed_work dwork;
+	u64 due_ns;		// expected start, for the latency statistics
+};
+
+static inline struct vcam_work *to_vcam_work(struct kthread_work *work)
+{
+	return container_of(work, struct vcam_work, dwork.work);
+}
+
+// Each vcam_work is queued at most once, a pending work coalesces further
+// requests, so depth is bounded by the number of work items.
+struct vcam_worker {
+	struct kthread_worker *kworker;
+	spinlock_t lock;	// protects everything below
+	int depth;		// queued works not started yet
+	int depth_max;
+	u64 runs;
+	u64 latency_ns;		// start latency, running average with 1/8 weight
+	u64 latency_max_ns;
+};
+
+// asynchronous mode switch queue, see vcamd.c
+struct vcam_async {
+	struct vcam_work work;
+	spinlock_t lock;	// protects everything below
+	wait_queue_head_t wait;	// woken on completion
+	struct list_head clients;
+	VCAMIOCTLASYNC pending;
+	u32 next_id;
+	u32 pending_id;		// 0 = none
+	u32 running_id;		// 0 = none
+	u32 done_id;
+	int done_result;
+	u32 done_seq;		// incremented on every completion
+};
+
+// FOV and mode change arbitration, see vcamd.c. Requests waiting for lock
+// merge into target, the first one to get the lock programs the merged
+// state and the others return its result. A request superseded by one for
+// another state fails with -EAGAIN.
+struct vcam_arb_waiter {
+	struct list_head node;	// in vcam_arb.waiters until done
+	unsigned int cmd;
+	VCAMIOCTLASYNC req;
+	bool done;
+	int result;
+};
+
+struct vcam_arb {
+	struct mutex lock;	// serialises state changes
+	spinlock_t slock;	// protects everything below and the waiters
+	unsigned int target_cmd;	// IOCTL_CAM_SET_FOV, _SET_CAMMODE or _ASYNC_SWITCH
+	VCAMIOCTLASYNC target;
+	struct list_head waiters;	// requests merged into target
+	int prio_count[VCAM_PRIO_COUNT];	// open clients per priority
+	u64 requests;
+	u64 coalesced;		// requests answered by another request
+};
+
+// frame timing measured from the VSYNC interrupt, see vcam_platform.c
+struct vcam_frames {
+	int irq;		// 0 if the board has no VSYNC GPIO
+	bool sysfs;		// statistics attributes created
+	spinlock_t lock;	// protects everything below
+	u64 count;		// VSYNC edges since probe
+	u64 last_ns;		// time of last edge, 0 after power off
+	u64 interval_ns;	// last inter-frame interval
+	u64 avg_ns;		// running average interval, 1/8 weight
+	u64 dropped;		// frames missing from intervals above 1.5 * avg_ns
+	wait_queue_head_t wait;	// woken on every VSYNC edge
+	int flash_edges;	// edges left of an armed torch flash, 0 = none
+};
+
+// per frame 3A statistics, sampled from the VSYNC interrupt thread
+struct vcam_stats {
+	atomic_t users;		// clients with notification enabled
+	spinlock_t lock;	// protects snap and seq
+	wait_queue_head_t wait;	// woken on every new snapshot
+	VCAMIOCTLSTATS snap;
+	u32 seq;		// incremented on every new snapshot, 0 = none yet
+};
+
+// per frame control requests, applied from the VSYNC interrupt thread
+#define VCAM_CTRL_DONE_LEN	16
+
+struct vcam_ctrl_queue {
+	spinlock_t lock;	// protects everything below
+	VCAMIOCTLCONTROLS pending[VCAM_CTRL_QUEUE_LEN];	// by targetFrame
+	int count;
+	VCAMIOCTLCONTROLSTATUS done[VCAM_CTRL_DONE_LEN];	// completion ring
+	unsigned int done_head;
+	u32 next_id;
+};
+
+// one per open file of /dev/vcam0
+struct vcam_client {
+	struct vcam_data *data;
+	struct list_head node;
+	struct eventfd_ctx *eventfd;
+	u32 done_seen;		// async.done_seq last reported to this client
+	bool stats_notify;	// IOCTL_CAM_SET_STATS_NOTIFY enabled
+	u32 stats_seen;		// stats.seq last returned to this client
+	int priority;		// VCAM_PRIO_*
+};
+
 // this structure keeps track of the device instance
 struct vcam_ops {
 	// Function pointers
@@ -27,7 +160,8 @@ struct vcam_ops {
 	int (*set_torchstate) (struct device *dev, VCAMIOCTLFLASH *pFlashData);
 	void (*set_power)(struct device *dev, bool enable);
 	int (*do_iocontrol)(struct device *dev, int cmd, PUCHAR buf, PUCHAR userbuf);
-	void (*deinitialize_hw)(struct device *dev);
+	void (*deinitialize_hw)(struct device *dev);	// remove entry points
+	void (*release_hw)(struct device *dev);	// power off, after the works
 };
 
 struct vcam_data {
@@ -37,21 +171,80 @@ struct vcam_data {
 	int i2c_address;
 	struct i2c_adapter *i2c_bus;
 	enum sensor_model sensor_model;
-	struct work_struct nightmode_work;
+	struct vcam_worker worker;	// runs all deferred sensor work
+	struct vcam_work nightmode_work;	// adaptive night mode controller
+	struct vcam_work still_revert_work;	// back to draft after IOCTL_CAM_GRAB_STILL
+	bool grab_pending;
+	u32 grab_gen;		// bumped by every still grab, under sem
+	struct vcam_work ae_release_work;	// AEC/AWB back to auto after a carried switch
+	bool ae_held;
+	int test_mode;		// VCAM_TEST_*, applied again after sensor init
+	VCAMIOCTLSTILLMODE still_mode;	// format of the next VCAM_STILL switch
+	unsigned int still_fps;	// 5MP frame rate, 9 or 15
+	bool jpeg_on;		// sensor JPEG output enabled
+	VCAMIOCTLFORMAT out_format;	// output format per mode
+	bool raw_on;		// sensor RAW output enabled
+	u8 raw_pll_ctrl;	// 0x3034 left by the mode program, restored after RAW
+	bool af_loaded;		// AF firmware downloaded this power cycle
+	bool af_continuous;
 	int flipped_sensor;	//if true the sensor is mounted upside/down.
 	int edge_enhancement;	//enable increased edge enhancement in camera sensor
 
 	int pwdn_gpio;
 	int reset_gpio;
 	int clk_en_gpio;
+	int vsync_gpio;
+
+	struct vcam_profile profile;
 
 	struct regulator *reg_vcm1i2c;
 	struct regulator *reg_vcm2i2c;
 	struct regulator *reg_vcm;
 
+	struct led_classdev *torch_led;	// cached torch LED, released with led_put()
+	struct vcam_work flash_work;	// ends a single frame flash
+	bool flash_active;	// under sem, cleared by flash_work
+	bool strobe_output;	// sensor STROBE pin drives the flash
+
 	struct semaphore sem;	// serialize access to this device's state
+
+	/* Camera state, published through the mmap:able status page */
+	int fov;
+	VCAM_Cam_Mode cam_mode;
+	bool flip;
+	bool mirror;
+	bool torch;
+	bool flash_ae_held;	// AEC manual for the torch exposure until torch off
+	VCAMIOCTLFLASHMETERING flash_metering;	// last torch on metering
+	bool powered;
+	u32 switch_gen;
+	u64 switch_start_ns;
+	u64 switch_end_ns;
+
+	VCAMSTATUS *status;	// one zeroed page, mapped read-only to userspace
+	spinlock_t status_lock;	// serialize status page writers
+
+	struct vcam_async async;
+	struct vcam_arb arb;
+
+	struct vcam_frames frames;
+	struct vcam_stats stats;
+	struct vcam_ctrl_queue ctrl;
+
+	struct ov5640_v4l2 *v4l2;	// V4L2 subdevice front-end, NULL if not registered
+
+	struct dentry *debugfs;
+	u8 *reg_shadow;			// last value written to each register
+	unsigned long *reg_written;	// bitmap of registers in reg_shadow
 };
 
 int platform_inithw(struct device *dev);
+void vcam_work_init(struct vcam_work *work, kthread_work_func_t fn);
+bool vcam_queue_work(struct vcam_data *data, struct vcam_work *work, unsigned long delay);
+void vcam_mod_work(struct vcam_data *data, struct vcam_work *work, unsigned long delay);
+void vcam_cancel_work_sync(struct vcam_data *data, struct vcam_work *work);
+void vcam_work_start(struct vcam_data *data, struct vcam_work *work);
+void vcam_status_publish(struct vcam_data *data);
+void vcam_frames_restart(struct vcam_data *data);
 
 #endif //_VCAM_INTERNAL_H_
@@ -11,8 +11,22 @@
 
 // Definitions
 
+/*
+ * bTestMode values, TRUE selects the color bars. In VCAM_TEST_SEQUENCE the
+ * bar style follows the frame number: frame n (VSYNC count, as in
+ * VCAMIOCTLSTATS.frame) shows style n % VCAM_TEST_SEQUENCE_LEN, on top of
+ * the rolling bar. A skipped or repeated style is a dropped or duplicated
+ * frame, mixed styles or a broken rolling bar a torn frame. The sequence
+ * needs the VSYNC interrupt.
+ */
+#define VCAM_TEST_OFF		0
+#define VCAM_TEST_BARS		1	// static color bars
+#define VCAM_TEST_ROLLING	2	// color bars with a bar moved every frame by the sensor
+#define VCAM_TEST_SEQUENCE	3	// rolling, bar style stepped every frame
+#define VCAM_TEST_SEQUENCE_LEN	4
+
 typedef struct _VCAMIOCTLTEST {
-	BOOL bTestMode;		// TRUE = Test mode, FALSE = normal image
+	BOOL bTestMode;		// VCAM_TEST_*, FALSE = normal image
 } VCAMIOCTLTEST, *PVCAMIOCTLTEST;
 
 typedef struct _VCAMIOCTLFOV {
@@ -24,6 +38,20 @@ typedef struct _VCAMIOCTLFLASH {
 	BOOL bFlashOn;		// TRUE = Flash activated one frame
 } VCAMIOCTLFLASH, *PVCAMIOCTLFLASH;
 
+/*
+ * Result of the pre-flash metering done when the torch is switched on.
+ * Exposure and gain are held at the values used until the torch is
+ * switched off. bMetered is FALSE when metering failed and the fixed
+ * fallback exposure was used instead.
+ */
+typedef struct _VCAMIOCTLFLASHMETERING {
+	BOOL bMetered;
+	unsigned int ambientLuma;	// average Y before the torch, 0-255
+	unsigned int torchLuma;		// average Y with the torch at ambient exposure
+	unsigned int exposure;		// 1/16 lines
+	unsigned int gain;		// 1/16 steps, 0x10 = 1x
+} VCAMIOCTLFLASHMETERING, *PVCAMIOCTLFLASHMETERING;
+
 typedef struct _VCAMIOCTLACTIVE {
 	BOOL bActive;		// TRUE = Visual camera is ON
 } VCAMIOCTLACTIVE, *PVCAMIOCTLACTIVE;
@@ -60,15 +88,198 @@ typedef enum {
 	VCAM_LARGE_JPEG,
 } VCAM_StillMode;
 
+/*
+ * Format of VCAM_STILL frames. SMALL is the full sensor array scaled to
+ * 1280x960, LARGE is 2592x1944. JPEG modes are compressed on the sensor,
+ * quality 1-100 sets the quantization scale, higher is larger and better,
+ * 0 keeps the sensor default. Applied at once when in VCAM_STILL,
+ * otherwise at the next switch to VCAM_STILL.
+ */
 typedef struct _VCAMIOCTLSTILLMODE {
 	VCAM_StillMode eStillMode;
+	unsigned int quality;	// JPEG quality, 0 = default
 } VCAMIOCTLSTILLMODE, *PVCAMIOCTLSTILLMODE;
 
+typedef enum {
+	VCAM_FMT_YUV422 = 0,
+	VCAM_FMT_RAW8,
+	VCAM_FMT_RAW10,
+} VCAM_OutputFormat;
+
+/*
+ * Output format per camera mode. RAW modes bypass the sensor ISP after
+ * defect pixel correction and deliver Bayer data, BGGR in the default
+ * orientation; flip and mirror shift the pattern. RAW needs the MIPI
+ * interface, a draft FOV that is not scaled in the ISP and the LARGE
+ * YCbCr still mode. Applied at once to the current mode.
+ */
+typedef struct _VCAMIOCTLFORMAT {
+	VCAM_OutputFormat eDraftFormat;
+	VCAM_OutputFormat eStillFormat;
+} VCAMIOCTLFORMAT, *PVCAMIOCTLFORMAT;
+
+typedef enum {
+	VCAM_FOCUS_IDLE = 0,	// AF firmware idle, lens released or paused
+	VCAM_FOCUS_BUSY,	// focusing
+	VCAM_FOCUS_DONE,	// single AF finished, or continuous AF in focus
+} VCAM_FocusState;
+
+// lensPos value requesting a single AF run when bAutoFocus is FALSE
+#define VCAM_FOCUS_SINGLE	(-1)
+// manual lensPos range, VCM DAC code, 0 = infinity
+#define VCAM_FOCUS_MAX		1023
+
 typedef struct _VCAMIOCTLFOCUS {
 	BOOL bAutoFocus;	// TRUE if auto focus requested
 	int lensPos;		// focus position for manual (non-autofocus) focus
+	VCAM_FocusState eState;	// IOCTL_CAM_GET_FOCUS only
 } VCAMIOCTLFOCUS, *PVCAMIOCTLFOCUS;
 
+/*
+ * Manual focus sweep, one lens position per frame. The lens is moved at
+ * the start of a frame and frame[i] is the number of the first frame
+ * started after lensPos[i] was written, comparable to VCAMIOCTLSTATS.frame.
+ * Without VSYNC interrupt the sweep is paced by the nominal frame period
+ * and frame[] is left 0. Autofocus is paused and the lens stays at the
+ * last position.
+ */
+#define VCAM_FOCUS_SWEEP_MAX	64
+
+typedef struct _VCAMIOCTLFOCUSSWEEP {
+	unsigned int count;				// positions used, 1..VCAM_FOCUS_SWEEP_MAX
+	int lensPos[VCAM_FOCUS_SWEEP_MAX];		// 0..VCAM_FOCUS_MAX
+	unsigned long long frame[VCAM_FOCUS_SWEEP_MAX];	// out
+} VCAMIOCTLFOCUSSWEEP, *PVCAMIOCTLFOCUSSWEEP;
+
+typedef struct _VCAMIOCTLASYNC {
+	VCAM_Cam_Mode eCamMode;	// VCAM_DRAFT or VCAM_STILL
+	int fov;		// draft FOV, 0 = keep current
+	unsigned int requestId;	// returned id of the queued request
+} VCAMIOCTLASYNC, *PVCAMIOCTLASYNC;
+
+/*
+ * Requests are executed in order and a queued request is superseded by a
+ * newer one. A request id is finished once completedId >= id; result is
+ * valid for completedId only. Superseded and cancelled requests are never
+ * applied.
+ */
+typedef struct _VCAMIOCTLASYNCSTATUS {
+	unsigned int pendingId;		// queued request, 0 = none
+	unsigned int runningId;		// request being applied, 0 = none
+	unsigned int completedId;	// last finished request
+	int result;			// 0 or negative errno of completedId
+} VCAMIOCTLASYNCSTATUS, *PVCAMIOCTLASYNCSTATUS;
+
+typedef struct _VCAMIOCTLEVENTFD {
+	int fd;			// eventfd signalled on async completion, -1 = none
+} VCAMIOCTLEVENTFD, *PVCAMIOCTLEVENTFD;
+
+/*
+ * 3A statistics, read from the sensor in one bulk transfer. frame is the
+ * VSYNC count the snapshot belongs to, 0 on boards without VSYNC interrupt.
+ */
+#define VCAM_STATS_AEC_STABLE	0x01	// avgLuma inside the AEC stable range
+#define VCAM_STATS_NIGHTMODE	0x02	// night mode enabled
+#define VCAM_STATS_AEC_MANUAL	0x04	// exposure and gain held
+#define VCAM_STATS_AWB_MANUAL	0x08	// white balance held
+
+typedef struct _VCAMIOCTLSTATS {
+	unsigned long long frame;		// frame number of the snapshot
+	unsigned long long timestampNs;		// CLOCK_MONOTONIC of the snapshot
+	unsigned int exposure;			// 1/16 lines
+	unsigned int gain;			// 1/16 steps, 0x10 = 1x
+	unsigned int awbGain[3];		// R G B, 0x400 = 1x
+	unsigned int avgLuma;			// average Y, 0-255
+	unsigned int flags;			// VCAM_STATS_*
+} VCAMIOCTLSTATS, *PVCAMIOCTLSTATS;
+
+/*
+ * With notification enabled, poll() reports EPOLLPRI when a new per frame
+ * snapshot is available and IOCTL_CAM_GET_STATS returns it without bus
+ * traffic. Per frame snapshots need the VSYNC interrupt.
+ */
+typedef struct _VCAMIOCTLSTATSNOTIFY {
+	BOOL bEnable;
+} VCAMIOCTLSTATSNOTIFY, *PVCAMIOCTLSTATSNOTIFY;
+
+/*
+ * Client priority, per open file. Only clients at the highest priority
+ * currently open may change the camera state, others get -EBUSY. At most
+ * one client can hold VCAM_PRIO_EXCLUSIVE. New files start at
+ * VCAM_PRIO_DEFAULT.
+ */
+#define VCAM_PRIO_BACKGROUND	0
+#define VCAM_PRIO_DEFAULT	1
+#define VCAM_PRIO_EXCLUSIVE	2
+#define VCAM_PRIO_COUNT		3
+
+typedef struct _VCAMIOCTLPRIORITY {
+	int priority;		// VCAM_PRIO_*
+} VCAMIOCTLPRIORITY, *PVCAMIOCTLPRIORITY;
+
+/*
+ * Per frame controls. A request carries the controls selected in mask and
+ * is written from the VSYNC interrupt thread in the frame before
+ * targetFrame, inside a sensor group hold so all values latch on the same
+ * frame boundary. With targetFrame 0 the target is the first frame
+ * starting at or after targetNs (CLOCK_MONOTONIC), with both 0 the next
+ * frame. Exposure and gain switch AEC/AGC to manual, awbGain switches AWB
+ * to manual, VCAM_CTRL_AUTO hands both back to automatic control.
+ * Requests need the VSYNC interrupt.
+ */
+#define VCAM_CTRL_EXPOSURE	0x01
+#define VCAM_CTRL_GAIN		0x02
+#define VCAM_CTRL_AWB		0x04
+#define VCAM_CTRL_AUTO		0x08
+#define VCAM_CTRL_QUEUE_LEN	8	// pending requests per device
+
+typedef struct _VCAMIOCTLCONTROLS {
+	unsigned int mask;			// VCAM_CTRL_*
+	unsigned int exposure;			// 1/16 lines
+	unsigned int gain;			// 1/16 steps, 0x10 = 1x
+	unsigned int awbGain[3];		// R G B, 0x400 = 1x
+	unsigned long long targetFrame;		// VSYNC count to apply to
+	unsigned long long targetNs;		// used when targetFrame is 0
+	unsigned int requestId;			// returned by the driver
+} VCAMIOCTLCONTROLS, *PVCAMIOCTLCONTROLS;
+
+/*
+ * Outcome of a control request. result is -EINPROGRESS while queued,
+ * -ENOENT once the request has aged out of the completion history.
+ * appliedFrame is the first frame exposed with the new values, later
+ * than the target if the request was late.
+ */
+typedef struct _VCAMIOCTLCONTROLSTATUS {
+	unsigned int requestId;			// in
+	int result;				// 0 or negative errno
+	unsigned long long appliedFrame;
+	unsigned long long appliedNs;		// expected start of appliedFrame
+} VCAMIOCTLCONTROLSTATUS, *PVCAMIOCTLCONTROLSTATUS;
+
+/*
+ * Read-only status page, mapped with mmap() of one page at offset 0 of
+ * /dev/vcam0. The driver increments seq before and after every update, so
+ * seq is odd while an update is in progress. A consistent snapshot is taken
+ * by reading seq (retry while odd), copying the fields and re-reading seq;
+ * retry if it changed. Use acquire/read barriers between the steps.
+ */
+#define VCAM_STATUS_VERSION	1
+
+typedef struct _VCAMSTATUS {
+	unsigned int version;	// VCAM_STATUS_VERSION
+	unsigned int seq;	// update sequence count, odd while updating
+	int fov;		// current draft FOV
+	VCAM_Cam_Mode eCamMode;	// current camera mode
+	BOOL bFlip;		// TRUE = image flipped
+	BOOL bMirror;		// TRUE = image mirrored
+	BOOL bTorchOn;		// TRUE = torch is ON
+	int sensorModel;	// 0 = standard OV5640, 1 = High K
+	BOOL bPowerOn;		// TRUE = sensor powered
+	unsigned int switchGen;	// incremented on every completed mode switch
+	unsigned long long switchStartNs;	// CLOCK_MONOTONIC start of last mode switch
+	unsigned long long switchEndNs;		// CLOCK_MONOTONIC end of last mode switch
+} VCAMSTATUS, *PVCAMSTATUS;
+
 // Public defines:
 
 // IOCTL codes.
@@ -78,6 +289,7 @@ typedef struct _VCAMIOCTLFOCUS {
 #define VCAM_IOCTL_R_W(code,type)	_IOR('v', code, type)
 #define VCAM_IOCTL_R(code,type)		_IOR('v', code, type)
 #define VCAM_IOCTL_N(code)		_IO('v', code)
+#define VCAM_IOCTL_RW(code,type)	_IOWR('v', code, type)
 
 #define IOCTL_CAM_GET_TEST		VCAM_IOCTL_R(1, VCAMIOCTLTEST)
 #define IOCTL_CAM_SET_TEST		VCAM_IOCTL_W(2, VCAMIOCTLTEST)
@@ -95,10 +307,14 @@ typedef struct _VCAMIOCTLFOCUS {
 #define IOCTL_CAM_SET_CAMMODE		VCAM_IOCTL_W(9, VCAMIOCTLCAMMODE)
 #define IOCTL_CAM_GET_CAMMODE		VCAM_IOCTL_R_W(10, VCAMIOCTLCAMMODE)
 
+// Switch to 5MP, return when the first fully exposed still frame is
+// available and revert to draft automatically a few frames later
 #define IOCTL_CAM_GRAB_STILL		VCAM_IOCTL_N(11)
 
+// Continuous AF with bAutoFocus, otherwise a single AF run for lensPos
+// VCAM_FOCUS_SINGLE. Returns at once, IOCTL_CAM_GET_FOCUS reports when done.
 #define IOCTL_CAM_SET_FOCUS		VCAM_IOCTL_W(12, VCAMIOCTLFOCUS)
-#define IOCTL_CAM_GET_FOCUS		VCAM_IOCTL_W(13, VCAMIOCTLFOCUS)
+#define IOCTL_CAM_GET_FOCUS		VCAM_IOCTL_R(13, VCAMIOCTLFOCUS)
 
 #define IOCTL_CAM_SET_2ND_ACTIVE	VCAM_IOCTL_W(14, VCAMIOCTLACTIVE)
 
@@ -114,4 +330,28 @@ typedef struct _VCAMIOCTLFOCUS {
 #define IOCTL_CAM_FLIP_ON		VCAM_IOCTL_N(21)
 #define IOCTL_CAM_FLIP_OFF		VCAM_IOCTL_N(22)
 
+#define IOCTL_CAM_ASYNC_SWITCH		VCAM_IOCTL_RW(23, VCAMIOCTLASYNC)
+#define IOCTL_CAM_ASYNC_CANCEL		VCAM_IOCTL_W(24, VCAMIOCTLASYNC)
+#define IOCTL_CAM_ASYNC_STATUS		VCAM_IOCTL_R(25, VCAMIOCTLASYNCSTATUS)
+#define IOCTL_CAM_SET_EVENTFD		VCAM_IOCTL_W(26, VCAMIOCTLEVENTFD)
+
+#define IOCTL_CAM_GET_STATS		VCAM_IOCTL_R(27, VCAMIOCTLSTATS)
+#define IOCTL_CAM_SET_STATS_NOTIFY	VCAM_IOCTL_W(28, VCAMIOCTLSTATSNOTIFY)
+
+#define IOCTL_CAM_FOCUS_SWEEP		VCAM_IOCTL_RW(29, VCAMIOCTLFOCUSSWEEP)
+
+#define IOCTL_CAM_SET_STILLMODE		VCAM_IOCTL_W(30, VCAMIOCTLSTILLMODE)
+#define IOCTL_CAM_GET_STILLMODE		VCAM_IOCTL_R(31, VCAMIOCTLSTILLMODE)
+
+#define IOCTL_CAM_GET_FLASH_METERING	VCAM_IOCTL_R(32, VCAMIOCTLFLASHMETERING)
+
+#define IOCTL_CAM_QUEUE_CONTROLS	VCAM_IOCTL_RW(33, VCAMIOCTLCONTROLS)
+#define IOCTL_CAM_CONTROL_STATUS	VCAM_IOCTL_RW(34, VCAMIOCTLCONTROLSTATUS)
+
+#define IOCTL_CAM_SET_PRIORITY		VCAM_IOCTL_W(35, VCAMIOCTLPRIORITY)
+#define IOCTL_CAM_GET_PRIORITY		VCAM_IOCTL_R(36, VCAMIOCTLPRIORITY)
+
+#define IOCTL_CAM_SET_FORMAT		VCAM_IOCTL_W(37, VCAMIOCTLFORMAT)
+#define IOCTL_CAM_GET_FORMAT		VCAM_IOCTL_R(38, VCAMIOCTLFORMAT)
+
 #endif /* __VCAM_IOCTL_H__ */
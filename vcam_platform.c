@@ -6,20 +6,32 @@
 #include <linux/i2c.h>
 #include <linux/leds.h>
 #include <linux/platform_device.h>
+#include <linux/interrupt.h>
+#include <linux/math64.h>
 
 #include <linux/of_gpio.h>
+#include <linux/gpio/consumer.h>
 #include <linux/of.h>
 #include <linux/regulator/consumer.h>
 #include <linux/regulator/of_regulator.h>
 #include "ov5640.h"
 // Function prototypes
 static void set_power(struct device *dev, bool enable);
+static void init_profile(struct device *dev);
 static int get_torchstate(struct device *dev, VCAMIOCTLFLASH *pFlashData);
 static int set_torchstate(struct device *dev, VCAMIOCTLFLASH *pFlashData);
+static struct led_classdev *get_torch(struct vcam_data *data);
+static void flash_off_work(struct kthread_work *work);
 static void set_suspend(struct device *dev, bool enable);
 static int do_iocontrol(struct device *dev, int cmd, PUCHAR buf, PUCHAR userbuf);
-struct led_classdev *find_torch(void);
+static struct led_classdev *find_torch(struct device *dev);
 static void deinitialize_hw(struct device *dev);
+static void release_hw(struct device *dev);
+
+/* VSYNC edges of a torch flash: on at the first, the frame started by the
+ * second is fully lit, off at the third
+ */
+#define VCAM_FLASH_EDGES	3
 
 static ssize_t vcam_eoco_power_store(struct device *dev, struct device_attribute *attr,
 				     const char *buf, size_t count)
@@ -30,16 +42,13 @@ static ssize_t vcam_eoco_power_store(struct device *dev, struct device_attribute
 	if (kstrtoul(buf, 0, &val) < 0)
 		return -EINVAL;
 	data->ops.set_power(dev, val);
-	if (val) {
-		ov5640_init(dev);
-	}
 	return count;
 }
 
 static ssize_t vcam_eoco_power_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
 	struct vcam_data *data = dev_get_drvdata(dev);
-	if (of_machine_is_compatible("fsl,imx6qp-eoco")) {
+	if (data->profile.eoco) {
 		sprintf(buf, "VCAM OV5640 Power state %s\n",
 			regulator_is_enabled(data->reg_vcm1i2c) ? "on":"off");
 	}
@@ -73,6 +82,271 @@ void vcam_eoco_remove_sysfs_attributes(struct device *dev)
 	sysfs_remove_group(&dev->kobj, &vcam_eoco_groups);
 }
 
+static ssize_t frame_count_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	unsigned long flags;
+	u64 count;
+
+	spin_lock_irqsave(&data->frames.lock, flags);
+	count = data->frames.count;
+	spin_unlock_irqrestore(&data->frames.lock, flags);
+
+	return sysfs_emit(buf, "%llu\n", count);
+}
+
+static ssize_t frame_interval_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	unsigned long flags;
+	u64 interval;
+
+	spin_lock_irqsave(&data->frames.lock, flags);
+	interval = data->frames.interval_ns;
+	spin_unlock_irqrestore(&data->frames.lock, flags);
+
+	return sysfs_emit(buf, "%llu\n", div_u64(interval, NSEC_PER_USEC));
+}
+
+static ssize_t fps_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	unsigned long flags;
+	u64 avg, mfps = 0;
+
+	spin_lock_irqsave(&data->frames.lock, flags);
+	avg = data->frames.last_ns ? data->frames.avg_ns : 0;
+	spin_unlock_irqrestore(&data->frames.lock, flags);
+
+	if (avg)
+		mfps = div64_u64(1000ULL * NSEC_PER_SEC, avg);
+
+	return sysfs_emit(buf, "%llu.%03llu\n", mfps / 1000, mfps % 1000);
+}
+
+static ssize_t dropped_frames_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	unsigned long flags;
+	u64 dropped;
+
+	spin_lock_irqsave(&data->frames.lock, flags);
+	dropped = data->frames.dropped;
+	spin_unlock_irqrestore(&data->frames.lock, flags);
+
+	return sysfs_emit(buf, "%llu\n", dropped);
+}
+
+static DEVICE_ATTR_RO(frame_count);
+static DEVICE_ATTR_RO(frame_interval);
+static DEVICE_ATTR_RO(fps);
+static DEVICE_ATTR_RO(dropped_frames);
+
+static struct attribute *vcam_frame_attrs[] = {
+	&dev_attr_frame_count.attr,
+	&dev_attr_frame_interval.attr,
+	&dev_attr_fps.attr,
+	&dev_attr_dropped_frames.attr,
+	NULL
+};
+
+static const struct attribute_group vcam_frame_groups = {
+	.attrs = vcam_frame_attrs,
+};
+
+//-----------------------------------------------------------------------------
+//
+// Function:  vsync_irq
+//
+// This function counts frames and measures the inter-frame interval on
+// every VSYNC edge. An interval longer than 1.5 times the running average
+// is counted as dropped frames, so the check follows night mode and AEC
+// frame rate changes instead of the nominal mode rate. The average keeps
+// tracking long intervals too, so a lasting rate drop stops counting.
+// It also switches a torch flash armed by set_torchstate on at a frame
+// start and ends it two frames later.
+//
+// Parameters:
+//
+// Returns:
+//
+//-----------------------------------------------------------------------------
+static irqreturn_t vsync_irq(int irq, void *dev_id)
+{
+	struct vcam_data *data = dev_id;
+	struct vcam_frames *frames = &data->frames;
+	u64 now = ktime_get_ns();
+	u64 interval;
+	int flash;
+
+	spin_lock(&frames->lock);
+	frames->count++;
+	flash = frames->flash_edges;
+	if (flash)
+		frames->flash_edges--;
+	if (frames->last_ns) {
+		interval = now - frames->last_ns;
+		frames->interval_ns = interval;
+		if (!frames->avg_ns) {
+			frames->avg_ns = interval;
+		} else {
+			if (2 * interval > 3 * frames->avg_ns)
+				frames->dropped += div64_u64(interval + frames->avg_ns / 2,
+							     frames->avg_ns) - 1;
+			frames->avg_ns = frames->avg_ns - (frames->avg_ns >> 3) + (interval >> 3);
+		}
+	}
+	frames->last_ns = now;
+	spin_unlock(&frames->lock);
+	wake_up_all(&frames->wait);
+
+	/* led_set_brightness() defers blocking LED drivers to a work */
+	if (flash == VCAM_FLASH_EDGES)
+		led_set_brightness(data->torch_led, data->torch_led->max_brightness);
+	else if (flash == 1)
+		vcam_mod_work(data, &data->flash_work, 0);
+
+	if (atomic_read(&data->stats.users) || READ_ONCE(data->ctrl.count) ||
+	    READ_ONCE(data->test_mode) == VCAM_TEST_SEQUENCE)
+		return IRQ_WAKE_THREAD;
+	return IRQ_HANDLED;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Function:  vsync_thread
+//
+// This function steps the test pattern sequence, writes the per frame
+// control requests due in the frame that just started and samples its 3A
+// statistics while a client has statistics notification enabled. During
+// mode switches statistics are skipped and due controls slip to the next
+// frame rather than waiting for the device.
+//
+// Parameters:
+//
+// Returns:
+//
+//-----------------------------------------------------------------------------
+static irqreturn_t vsync_thread(int irq, void *dev_id)
+{
+	struct vcam_data *data = dev_id;
+	VCAMIOCTLSTATS snap;
+	bool stats, controls;
+	u64 frame;
+	int ret;
+
+	spin_lock_irq(&data->frames.lock);
+	frame = data->frames.count;
+	spin_unlock_irq(&data->frames.lock);
+
+	if (data->powered)
+		ov5640_test_frame(data->dev, frame);
+
+	stats = atomic_read(&data->stats.users);
+	controls = ov5640_controls_due(data->dev, frame);
+	if ((!stats && !controls) || down_trylock(&data->sem))
+		return IRQ_HANDLED;
+
+	if (!data->powered || data->cam_mode == VCAM_UNDEFINED) {
+		up(&data->sem);
+		return IRQ_HANDLED;
+	}
+
+	if (controls)
+		ov5640_apply_controls(data->dev, frame);
+
+	if (!stats) {
+		up(&data->sem);
+		return IRQ_HANDLED;
+	}
+
+	snap.frame = frame;
+
+	ret = ov5640_read_stats(data->dev, &snap);
+	up(&data->sem);
+	if (ret)
+		return IRQ_HANDLED;
+
+	spin_lock_irq(&data->stats.lock);
+	data->stats.snap = snap;
+	if (++data->stats.seq == 0)
+		data->stats.seq = 1;
+	spin_unlock_irq(&data->stats.lock);
+	wake_up_interruptible(&data->stats.wait);
+
+	return IRQ_HANDLED;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Function:  vcam_frames_restart
+//
+// This function restarts interval measurement after power off or a mode
+// switch, where the gap and the new frame rate are expected.
+//
+// Parameters:
+//
+// Returns:
+//
+//-----------------------------------------------------------------------------
+void vcam_frames_restart(struct vcam_data *data)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&data->frames.lock, flags);
+	data->frames.last_ns = 0;
+	data->frames.avg_ns = 0;
+	spin_unlock_irqrestore(&data->frames.lock, flags);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Function:  init_vsync
+//
+// This function requests the optional VSYNC (or FPGA frame start) GPIO
+// interrupt from device tree. Boards without it have no frame statistics.
+//
+// Parameters:
+//
+// Returns: 0 on success or if no VSYNC GPIO is given
+//
+//-----------------------------------------------------------------------------
+static int init_vsync(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	int ret;
+
+	spin_lock_init(&data->frames.lock);
+	init_waitqueue_head(&data->frames.wait);
+
+	data->vsync_gpio = of_get_named_gpio_flags(dev->of_node, "vcam_vsync-gpio", 0, NULL);
+	if (!gpio_is_valid(data->vsync_gpio))
+		return 0;
+
+	ret = devm_gpio_request_one(dev, data->vsync_gpio, GPIOF_IN, "vcam_vsync-gpio");
+	if (ret) {
+		dev_err(dev, "Failed registering pin vcam_vsync-gpio (err %i)\n", ret);
+		return ret;
+	}
+
+	ret = gpio_to_irq(data->vsync_gpio);
+	if (ret < 0) {
+		dev_err(dev, "vcam_vsync-gpio has no interrupt (err %i)\n", ret);
+		return ret;
+	}
+
+	data->frames.irq = ret;
+	ret = devm_request_threaded_irq(dev, data->frames.irq, vsync_irq, vsync_thread,
+					IRQF_TRIGGER_RISING | IRQF_ONESHOT, "vcam_vsync", data);
+	if (ret) {
+		dev_err(dev, "Failed requesting VSYNC interrupt (err %i)\n", ret);
+		data->frames.irq = 0;
+		return ret;
+	}
+
+	return 0;
+}
+
 
 
 
@@ -81,7 +355,10 @@ void vcam_eoco_remove_sysfs_attributes(struct device *dev)
 //
 // Function:  set_power
 //
-// This function will control standby/on GPIO usage
+// This function will control standby/on GPIO usage, using the board
+// profile resolved at probe. Timings are the OV5640 datasheet minimums;
+// instead of waiting the worst case SCCB startup time after reset, the
+// chip id is polled until the sensor answers.
 //
 // Parameters:
 //
@@ -92,46 +369,85 @@ static void set_power(struct device *dev, bool enable)
 {
 	int ret = 0;
 	struct vcam_data *data = dev_get_drvdata(dev);
+	struct vcam_profile *profile = &data->profile;
+
 	if (enable) {
 		ret = regulator_enable(data->reg_vcm);
-		usleep_range(1000, 10000);
-		if (of_machine_is_compatible("fsl,imx6qp-eoco")) {
-			gpio_direction_output(data->clk_en_gpio, 1);
-		} else {
-			gpio_direction_output(data->clk_en_gpio, 0);
-		} 
-		gpio_direction_output(data->pwdn_gpio, 0);
-		usleep_range(1000, 10000);
-		if (of_machine_is_compatible("fsl,imx6qp-eoco")) {
-			gpio_direction_output(data->reset_gpio, 0);
-		} else {
-			gpio_direction_output(data->reset_gpio, 1);
-		}
-		if (of_machine_is_compatible("fsl,imx6qp-eoco")) {
+		if (ret)
+			dev_err(dev, "Failed to enable VCM_DOVDD (%i)\n", ret);
+
+		/* clock on and out of power down together, reset still asserted */
+		gpiod_set_raw_array_value_cansleep(VCAM_GPIO_COUNT, profile->gpios, NULL, &profile->clocked_values);
+		usleep_range(OV5640_PWDN_TO_RESET_US, OV5640_PWDN_TO_RESET_US + 100);
+		gpiod_set_raw_array_value_cansleep(VCAM_GPIO_COUNT, profile->gpios, NULL, &profile->on_values);
+
+		if (profile->eoco) {
 			ret = regulator_enable(data->reg_vcm1i2c);
+			if (ret)
+				dev_err(dev, "Failed to enable EODC_I2C_ENABLE (%i)\n", ret);
 		}
+
+		ret = ov5640_wait_ready(dev);
+		if (ret)
+			dev_err(dev, "Sensor not answering after power on (%i)\n", ret);
+		data->powered = true;
 	} else {
-		if (of_machine_is_compatible("fsl,imx6qp-eoco")) {
+		if (profile->eoco)
 			regulator_disable(data->reg_vcm1i2c);
-		}
-		if (of_machine_is_compatible("fsl,imx6qp-eoco")) {
-			gpio_direction_output(data->reset_gpio, 1);
-		} else {
-			gpio_direction_output(data->reset_gpio, 0);
-		}			
-		usleep_range(10000, 20000);
-		gpio_direction_output(data->pwdn_gpio, 1);
-		if (of_machine_is_compatible("fsl,imx6qp-eoco")) {
-			gpio_direction_output(data->clk_en_gpio, 0);
-		} else {
-			gpio_direction_output(data->clk_en_gpio, 1);
-		}
-		usleep_range(10000, 20000);
+
+		gpiod_set_raw_array_value_cansleep(VCAM_GPIO_COUNT, profile->gpios, NULL, &profile->off_values);
 		ret = regulator_disable(data->reg_vcm);
+		data->powered = false;
+		/* registers are lost, there is no mode or AEC state to carry */
+		data->cam_mode = VCAM_UNDEFINED;
+		data->ae_held = false;
+		data->flash_ae_held = false;
+		data->af_loaded = false;
+		data->af_continuous = false;
+		data->jpeg_on = false;
+		data->raw_on = false;
+
+		/* the gap until the next power on is not a frame interval */
+		vcam_frames_restart(data);
 	}
+	vcam_status_publish(data);
 }
 
-
+//-----------------------------------------------------------------------------
+//
+// Function:  init_profile
+//
+// This function resolves the board variant, GPIO levels and sensor
+// interface once, so that power sequencing does not look them up again.
+// The GPIO descriptors are filled in as the pins are requested.
+//
+// Parameters:
+//
+// Returns:
+//
+//-----------------------------------------------------------------------------
+static void init_profile(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct vcam_profile *profile = &data->profile;
+	unsigned long clk_on, reset_run;
+
+	profile->eoco = of_machine_is_compatible("fsl,imx6qp-eoco");
+	profile->parallel_interface = of_property_read_bool(dev->of_node, VCAM_PARALLELL_INTERFACE);
+	if (of_property_read_u32(dev->of_node, "vcam_mipi_max_mbps", &profile->mipi_max_mbps))
+		profile->mipi_max_mbps = 0;
+
+	/* eoco has active high clock enable and active high reset */
+	clk_on = profile->eoco ? 1 : 0;
+	reset_run = profile->eoco ? 0 : 1;
+
+	profile->off_values = (!clk_on << VCAM_GPIO_CLK_EN) | (1 << VCAM_GPIO_PWDN) |
+			      (!reset_run << VCAM_GPIO_RESET);
+	profile->clocked_values = (clk_on << VCAM_GPIO_CLK_EN) | (0 << VCAM_GPIO_PWDN) |
+				  (!reset_run << VCAM_GPIO_RESET);
+	profile->on_values = (clk_on << VCAM_GPIO_CLK_EN) | (0 << VCAM_GPIO_PWDN) |
+			     (reset_run << VCAM_GPIO_RESET);
+}
 
 //-----------------------------------------------------------------------------
 //
@@ -154,13 +470,23 @@ int platform_inithw(struct device *dev)
 
 	data->i2c_address = 0x78;
 	data->edge_enhancement = 1;
+	data->fov = 54;
+	data->still_mode.eStillMode = VCAM_LARGE_YCbCr;
+	data->still_fps = 9;
+	data->cam_mode = VCAM_UNDEFINED;
+	data->strobe_output = of_property_read_bool(dev->of_node, "vcam_strobe_output");
+	vcam_work_init(&data->flash_work, flash_off_work);
+	ov5640_init_work(dev);
 	data->ops.get_torchstate = get_torchstate;
 	data->ops.set_torchstate = set_torchstate;
 	data->ops.do_iocontrol = do_iocontrol;
 	data->ops.set_power = set_power;
 	data->ops.deinitialize_hw = deinitialize_hw;
+	data->ops.release_hw = release_hw;
 
-	if (of_machine_is_compatible("fsl,imx6qp-eoco")) {
+	init_profile(dev);
+
+	if (data->profile.eoco) {
 		data->i2c_bus = i2c_get_adapter(0);
 	} else {
 		data->i2c_bus = i2c_get_adapter(2);
@@ -173,6 +499,7 @@ int platform_inithw(struct device *dev)
 			dev_err(dev, "Failed registering pin vcam_reset-gpio (err %i)\n", ret);
 			return ret;
 		}
+		data->profile.gpios[VCAM_GPIO_RESET] = gpio_to_desc(data->reset_gpio);
 	} else {
 		dev_err(dev, "vcam_reset not detected\n");
 		return -EIO;
@@ -185,6 +512,7 @@ int platform_inithw(struct device *dev)
 			dev_err(dev, "Failed registering pin vcam_pwdn-gpio (err %i)\n", ret);
 			return ret;
 		}
+		data->profile.gpios[VCAM_GPIO_PWDN] = gpio_to_desc(data->pwdn_gpio);
 	} else {
 		dev_err(dev, "vcam_pwdn not detected\n");
 		return -EIO;
@@ -197,12 +525,17 @@ int platform_inithw(struct device *dev)
 			dev_err(dev, "Failed registering pin vcam_clk_en-gpio (err %i)\n", ret);
 			return ret;
 		}
+		data->profile.gpios[VCAM_GPIO_CLK_EN] = gpio_to_desc(data->clk_en_gpio);
 	} else {
 		dev_err(dev, "vcam_clk_en-gpio not detected\n");
 		return -EIO;
 	}
 
-	if (of_machine_is_compatible("fsl,imx6qp-eoco")) {
+	ret = init_vsync(dev);
+	if (ret)
+		return ret;
+
+	if (data->profile.eoco) {
 		data->reg_vcm = devm_regulator_get(dev, "eodc_dovdd");
 		if (IS_ERR(data->reg_vcm)) {
 			dev_err(dev, "VCAM: Error fetching regulator VCM_DOVDD\n");
@@ -217,7 +550,7 @@ int platform_inithw(struct device *dev)
 	}
 
 
-	if (of_machine_is_compatible("fsl,imx6qp-eoco")) {
+	if (data->profile.eoco) {
 		data->reg_vcm1i2c = devm_regulator_get(dev, "EODC_I2C_ENABLE");
 		if (IS_ERR(data->reg_vcm1i2c)) {
 			dev_err(dev, "VCAM: Error fetching regulator EODC_I2C_ENABLE\n");
@@ -226,7 +559,6 @@ int platform_inithw(struct device *dev)
 	}
 
 	data->ops.set_power(dev, true);
-	ov5640_init(dev);
 
 	ret = vcam_eoco_create_sysfs_attributes(dev);
 	if (ret)
@@ -236,6 +568,19 @@ int platform_inithw(struct device *dev)
 	if (ret)
 		goto out_sysfs;
 
+	if (data->frames.irq) {
+		data->frames.sysfs = !sysfs_create_group(&dev->kobj, &vcam_frame_groups);
+		if (!data->frames.sysfs)
+			dev_warn(dev, "frame statistics not available in sysfs\n");
+	}
+
+	if (ov5640_debugfs_init(dev))
+		dev_warn(dev, "debugfs entries not created\n");
+
+	/* /dev/vcam0 stays usable without the V4L2 front-end */
+	if (ov5640_v4l2_register(dev))
+		dev_warn(dev, "V4L2 subdevice not registered\n");
+
 	return ret;
 	
 out_sysfs:
@@ -246,6 +591,26 @@ out_eoco_sysfs:
 }
 
 
+//-----------------------------------------------------------------------------
+//
+// Function:  get_torch
+//
+// This function returns the cached torch LED, looking it up on first use
+// since the LED driver may probe after us. Called with data->sem held.
+//
+// Parameters:
+//
+// Returns: struct *led_cdev NULL if not found
+//
+//-----------------------------------------------------------------------------
+static struct led_classdev *get_torch(struct vcam_data *data)
+{
+	if (!data->torch_led)
+		data->torch_led = find_torch(data->dev);
+
+	return data->torch_led;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Function:  get_torchstate
@@ -259,8 +624,9 @@ out_eoco_sysfs:
 //-----------------------------------------------------------------------------
 int get_torchstate(struct device *dev, VCAMIOCTLFLASH *pFlashData)
 {
+	struct vcam_data *data = dev_get_drvdata(dev);
 	int ret;
-	struct led_classdev *led = find_torch();
+	struct led_classdev *led = get_torch(data);
 
 	if (led) {
 		pFlashData->bTorchOn = (led->brightness) ? TRUE : FALSE;
@@ -275,7 +641,7 @@ int get_torchstate(struct device *dev, VCAMIOCTLFLASH *pFlashData)
 		ret = ERROR_SUCCESS;
 	}
 
-	pFlashData->bFlashOn = FALSE;
+	pFlashData->bFlashOn = data->flash_active;
 	return ret;
 }
 
@@ -284,7 +650,12 @@ int get_torchstate(struct device *dev, VCAMIOCTLFLASH *pFlashData)
 //
 // Function:  set_torchstate
 //
-// This function will set torch and flash state.
+// This function will set torch state and fire a single frame flash when
+// bFlashOn is set. The flash uses the sensor STROBE output if the board
+// wires it to the flash driver. Otherwise vsync_irq switches the torch LED
+// on at a frame start and off two frames later, so that one complete frame
+// is exposed with it; flash_work ends it if no VSYNC comes. Boards without
+// the VSYNC interrupt switch the LED on for two frame periods instead.
 //
 // Parameters:
 //
@@ -293,26 +664,83 @@ int get_torchstate(struct device *dev, VCAMIOCTLFLASH *pFlashData)
 //-----------------------------------------------------------------------------
 int set_torchstate(struct device *dev, VCAMIOCTLFLASH *pFlashData)
 {
-	int ret;
-	struct led_classdev *led = find_torch();
+	struct vcam_data *data = dev_get_drvdata(dev);
+	int ret = ERROR_SUCCESS;
+	struct led_classdev *led = get_torch(data);
 
 	if (led) {
-		led->brightness =
-		    pFlashData->bTorchOn ? led->max_brightness : 0;
-		led->brightness_set(led, led->brightness);
-		ret = ERROR_SUCCESS;
+		/* led_set_brightness() defers blocking LED drivers to a work */
+		led_set_brightness(led, pFlashData->bTorchOn ? led->max_brightness : LED_OFF);
+		data->torch = pFlashData->bTorchOn;
+		vcam_status_publish(data);
 	} else {
 		dev_err_once(dev, "Failed to find LED Flash\n");
 
 		//Here we want to return ERROR_INVALID_HANDLE, but due to appcore and webapplications, we need
 		//this to succeed, until underlying software is able to handle fails here!
 		// ret = ERROR_INVALID_HANDLE;
-		ret = ERROR_SUCCESS;
+	}
+
+	if (pFlashData->bFlashOn && !data->flash_active) {
+		unsigned int frames = 2;
+
+		if (data->strobe_output) {
+			ret = ov5640_set_strobe(dev, true);
+			if (ret) {
+				dev_err(dev, "Failed to request flash strobe\n");
+				return ret;
+			}
+		} else if (led && data->frames.irq) {
+			spin_lock_irq(&data->frames.lock);
+			data->frames.flash_edges = VCAM_FLASH_EDGES;
+			spin_unlock_irq(&data->frames.lock);
+			/* watchdog, vsync_irq moves it to the third edge */
+			frames = VCAM_FLASH_EDGES + 2;
+		} else if (led) {
+			led_set_brightness(led, led->max_brightness);
+		} else {
+			return ret;
+		}
+
+		data->flash_active = true;
+		vcam_queue_work(data, &data->flash_work,
+				usecs_to_jiffies(frames * ov5640_frame_period_us(dev)));
 	}
 
 	return ret;
 }
 
+//-----------------------------------------------------------------------------
+//
+// Function:  flash_off_work
+//
+// This function ends a single frame flash and restores the torch state
+//
+// Parameters:
+//
+// Returns:
+//
+//-----------------------------------------------------------------------------
+static void flash_off_work(struct kthread_work *work)
+{
+	struct vcam_data *data = container_of(to_vcam_work(work), struct vcam_data, flash_work);
+
+	vcam_work_start(data, to_vcam_work(work));
+
+	down(&data->sem);
+	spin_lock_irq(&data->frames.lock);
+	data->frames.flash_edges = 0;
+	spin_unlock_irq(&data->frames.lock);
+
+	if (data->strobe_output)
+		ov5640_set_strobe(data->dev, false);
+	else if (data->torch_led)
+		led_set_brightness(data->torch_led, data->torch ? data->torch_led->max_brightness : LED_OFF);
+
+	data->flash_active = false;
+	up(&data->sem);
+}
+
 //-----------------------------------------------------------------------------
 //
 // Function: set_supend
@@ -326,12 +754,7 @@ int set_torchstate(struct device *dev, VCAMIOCTLFLASH *pFlashData)
 //-----------------------------------------------------------------------------
 static void set_suspend(struct device *dev, bool enable)
 {
-	if (enable) {
-		set_power(dev, false);
-	} else {
-		set_power(dev, true);
-		ov5640_init(dev);
-	}
+	set_power(dev, !enable);
 }
 
 static int do_iocontrol(struct device *dev, int cmd, PUCHAR buf, PUCHAR userbuf)
@@ -363,27 +786,39 @@ static int do_iocontrol(struct device *dev, int cmd, PUCHAR buf, PUCHAR userbuf)
 //
 // Function:  find_torch
 //
-// This function will return LED named "torch" from the kernel list of LEDS
+// This function will return the torch LED referenced by the "leds"
+// property of the device node, or the LED named "torch" on boards without
+// it. The reference keeps the LED and its driver module loaded, release
+// it with led_put().
 //
-// Parameters: None
+// Parameters:
 //
-// Returns: struct *led_cdev NULL if not found
+// Returns: struct *led_cdev NULL if not found or not registered yet
 //
 //-----------------------------------------------------------------------------
-struct led_classdev *find_torch(void)
+static struct led_classdev *find_torch(struct device *dev)
 {
 	extern struct list_head leds_list;
 	extern struct rw_semaphore leds_list_lock;
-	/* Find torch */
-	struct led_classdev *led_cdev, *led = NULL;
+	struct led_classdev *led_cdev, *led = of_led_get(dev->of_node, 0);
 
+	if (!IS_ERR(led))
+		return led;
+	if (PTR_ERR(led) != -ENOENT)
+		return NULL;
+
+	/* no phandle, take the same references as of_led_get() */
+	led = NULL;
 	down_read(&leds_list_lock);
 	list_for_each_entry(led_cdev, &leds_list, node) {
-		if (led_cdev && led_cdev->name &&
-		    strcmp(led_cdev->name, "torch") == 0) {
+		if (!led_cdev->name || strcmp(led_cdev->name, "torch"))
+			continue;
+		if (led_cdev->dev->parent && led_cdev->dev->parent->driver &&
+		    try_module_get(led_cdev->dev->parent->driver->owner)) {
+			get_device(led_cdev->dev);
 			led = led_cdev;
-			break;
 		}
+		break;
 	}
 	up_read(&leds_list_lock);
 
@@ -395,10 +830,41 @@ static void deinitialize_hw(struct device *dev)
 {
 	struct vcam_data *data = dev_get_drvdata(dev);
 
+	/* no new frames or sensor work from the VSYNC thread */
+	if (data->frames.irq) {
+		devm_free_irq(dev, data->frames.irq, data);
+		data->frames.irq = 0;
+	}
+
+	ov5640_v4l2_unregister(dev);
+	ov5640_debugfs_remove(dev);
 	ov5640_remove_sysfs_attributes(dev);
 	vcam_eoco_remove_sysfs_attributes(dev);
-		
+	if (data->frames.sysfs)
+		sysfs_remove_group(&dev->kobj, &vcam_frame_groups);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Function:  release_hw
+//
+// This function powers the sensor off and releases the torch and the I2C
+// adapter. Called after deinitialize_hw, once the sensor works are
+// cancelled.
+//
+// Parameters:
+//
+// Returns:
+//
+//-----------------------------------------------------------------------------
+static void release_hw(struct device *dev)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+
+	if (data->torch_led)
+		led_put(data->torch_led);
+
 	data->ops.set_power(dev, false);
-	
+
 	i2c_put_adapter(data->i2c_bus);
 }
@@ -14,14 +14,750 @@
 #include "i2cdev.h"
 #include <linux/platform_device.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/eventfd.h>
+#include <linux/slab.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+
+static bool worker_fifo = true;
+module_param(worker_fifo, bool, 0444);
+MODULE_PARM_DESC(worker_fifo, "Run the sensor worker SCHED_FIFO at the default RT priority, else normal scheduling, default = Y");
+
+static int worker_cpu = -1;
+module_param(worker_cpu, int, 0444);
+MODULE_PARM_DESC(worker_cpu, "CPU the sensor worker is bound to, default = -1 (any)");
 // Function prototypes
 static long vcam_iocontrol(struct file *filep, unsigned int cmd, unsigned long arg);
+static int vcam_mmap(struct file *filep, struct vm_area_struct *vma);
+static int vcam_open(struct inode *inode, struct file *filep);
+static int vcam_release(struct inode *inode, struct file *filep);
+static __poll_t vcam_poll(struct file *filep, poll_table *wait);
+static void vcam_stats_notify(struct vcam_client *client, bool enable);
 
 static const struct file_operations vcam_fops = {
 	.owner = THIS_MODULE,
+	.open = vcam_open,
+	.release = vcam_release,
 	.unlocked_ioctl = vcam_iocontrol,
+	.mmap = vcam_mmap,
+	.poll = vcam_poll,
 };
 
+/* vcam_status_publish
+ *
+ * Copy the current camera state to the status page. Readers in userspace
+ * use the seq field to detect and retry torn snapshots.
+ */
+void vcam_status_publish(struct vcam_data *data)
+{
+	VCAMSTATUS *status = data->status;
+	unsigned long flags;
+
+	if (!status)
+		return;
+
+	spin_lock_irqsave(&data->status_lock, flags);
+	WRITE_ONCE(status->seq, status->seq + 1);
+	smp_wmb();
+
+	status->fov = data->fov;
+	status->eCamMode = data->cam_mode;
+	status->bFlip = data->flip;
+	status->bMirror = data->mirror;
+	status->bTorchOn = data->torch;
+	status->sensorModel = data->sensor_model;
+	status->bPowerOn = data->powered;
+	status->switchGen = data->switch_gen;
+	status->switchStartNs = data->switch_start_ns;
+	status->switchEndNs = data->switch_end_ns;
+
+	smp_wmb();
+	WRITE_ONCE(status->seq, status->seq + 1);
+	spin_unlock_irqrestore(&data->status_lock, flags);
+}
+
+/* vcam_mmap
+ *
+ * Map the status page read-only into the caller. Only a single page at
+ * offset 0 is available.
+ */
+static int vcam_mmap(struct file *filep, struct vm_area_struct *vma)
+{
+	struct vcam_client *client = filep->private_data;
+	struct vcam_data *data = client->data;
+
+	if (vma->vm_pgoff != 0 || vma_pages(vma) != 1)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+
+	return vm_insert_page(vma, vma->vm_start, virt_to_page(data->status));
+}
+
+/* vcam_prio_max
+ *
+ * Highest priority of the open clients. Called with async.lock held.
+ */
+static int vcam_prio_max(struct vcam_data *data)
+{
+	int prio;
+
+	for (prio = VCAM_PRIO_COUNT - 1; prio > VCAM_PRIO_BACKGROUND; prio--)
+		if (data->arb.prio_count[prio])
+			break;
+	return prio;
+}
+
+/* vcam_prio_set
+ *
+ * Returns 0 on success
+ *         -EINVAL for an unknown priority
+ *         -EBUSY if another client holds VCAM_PRIO_EXCLUSIVE
+ */
+static int vcam_prio_set(struct vcam_client *client, int prio)
+{
+	struct vcam_data *data = client->data;
+	int ret = 0;
+
+	if (prio < VCAM_PRIO_BACKGROUND || prio >= VCAM_PRIO_COUNT)
+		return -EINVAL;
+
+	spin_lock_irq(&data->async.lock);
+	if (prio == VCAM_PRIO_EXCLUSIVE && client->priority != prio &&
+	    data->arb.prio_count[VCAM_PRIO_EXCLUSIVE]) {
+		ret = -EBUSY;
+	} else {
+		data->arb.prio_count[client->priority]--;
+		data->arb.prio_count[prio]++;
+		client->priority = prio;
+	}
+	spin_unlock_irq(&data->async.lock);
+
+	return ret;
+}
+
+/* vcam_prio_check
+ *
+ * Returns 0 if the client may change the camera state
+ *         -EBUSY if a client with higher priority is open
+ */
+static int vcam_prio_check(struct vcam_client *client)
+{
+	struct vcam_data *data = client->data;
+	int ret;
+
+	spin_lock_irq(&data->async.lock);
+	ret = client->priority < vcam_prio_max(data) ? -EBUSY : 0;
+	spin_unlock_irq(&data->async.lock);
+
+	return ret;
+}
+
+/* vcam_changes_state
+ *
+ * True for the ioctls subject to client priority
+ */
+static bool vcam_changes_state(unsigned int cmd)
+{
+	switch (cmd) {
+	case IOCTL_CAM_INIT:
+	case IOCTL_CAM_SET_FLASH:
+	case IOCTL_CAM_SET_CAMMODE:
+	case IOCTL_CAM_GRAB_STILL:
+	case IOCTL_CAM_SET_FOCUS:
+	case IOCTL_CAM_SET_FOV:
+	case IOCTL_CAM_SUSPEND:
+	case IOCTL_CAM_RESUME:
+	case IOCTL_CAM_MIRROR_ON:
+	case IOCTL_CAM_MIRROR_OFF:
+	case IOCTL_CAM_FLIP_ON:
+	case IOCTL_CAM_FLIP_OFF:
+	case IOCTL_CAM_ASYNC_SWITCH:
+	case IOCTL_CAM_ASYNC_CANCEL:
+	case IOCTL_CAM_SET_TEST:
+	case IOCTL_CAM_FOCUS_SWEEP:
+	case IOCTL_CAM_SET_STILLMODE:
+	case IOCTL_CAM_QUEUE_CONTROLS:
+	case IOCTL_CAM_SET_FORMAT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* vcam_open
+ *
+ * Allocate the per-file client context. misc_open() has set private_data
+ * to our miscdevice.
+ */
+static int vcam_open(struct inode *inode, struct file *filep)
+{
+	struct vcam_data *data = container_of(filep->private_data, struct vcam_data, miscdev);
+	struct vcam_client *client = kzalloc(sizeof(*client), GFP_KERNEL);
+
+	if (!client)
+		return -ENOMEM;
+
+	client->data = data;
+	client->priority = VCAM_PRIO_DEFAULT;
+
+	spin_lock_irq(&data->async.lock);
+	client->done_seen = data->async.done_seq;
+	list_add_tail(&client->node, &data->async.clients);
+	data->arb.prio_count[client->priority]++;
+	spin_unlock_irq(&data->async.lock);
+
+	filep->private_data = client;
+	return 0;
+}
+
+static int vcam_release(struct inode *inode, struct file *filep)
+{
+	struct vcam_client *client = filep->private_data;
+	struct vcam_data *data = client->data;
+
+	spin_lock_irq(&data->async.lock);
+	list_del(&client->node);
+	data->arb.prio_count[client->priority]--;
+	spin_unlock_irq(&data->async.lock);
+
+	vcam_stats_notify(client, false);
+
+	if (client->eventfd)
+		eventfd_ctx_put(client->eventfd);
+	kfree(client);
+	return 0;
+}
+
+/* vcam_poll
+ *
+ * Readable when an asynchronous request has completed since the client
+ * last fetched IOCTL_CAM_ASYNC_STATUS. Priority data when a statistics
+ * snapshot is available that the client has not fetched.
+ */
+static __poll_t vcam_poll(struct file *filep, poll_table *wait)
+{
+	struct vcam_client *client = filep->private_data;
+	struct vcam_data *data = client->data;
+	__poll_t mask = 0;
+
+	poll_wait(filep, &data->async.wait, wait);
+	poll_wait(filep, &data->stats.wait, wait);
+
+	if (READ_ONCE(data->async.done_seq) != READ_ONCE(client->done_seen))
+		mask |= EPOLLIN | EPOLLRDNORM;
+	if (client->stats_notify &&
+	    READ_ONCE(data->stats.seq) != READ_ONCE(client->stats_seen))
+		mask |= EPOLLPRI;
+	return mask;
+}
+
+/* vcam_stats_notify
+ *
+ * Enable or disable per frame statistics snapshots for a client
+ */
+static void vcam_stats_notify(struct vcam_client *client, bool enable)
+{
+	struct vcam_stats *stats = &client->data->stats;
+
+	spin_lock_irq(&stats->lock);
+	if (enable == client->stats_notify) {
+		spin_unlock_irq(&stats->lock);
+		return;
+	}
+	client->stats_notify = enable;
+	client->stats_seen = stats->seq;
+	spin_unlock_irq(&stats->lock);
+
+	if (enable)
+		atomic_inc(&stats->users);
+	else
+		atomic_dec(&stats->users);
+}
+
+/* vcam_stats_cached
+ *
+ * Copy the latest per frame snapshot, if the client has notification
+ * enabled and one exists
+ *
+ * Returns true if stats was filled in
+ */
+static bool vcam_stats_cached(struct vcam_client *client, VCAMIOCTLSTATS *out)
+{
+	struct vcam_stats *stats = &client->data->stats;
+	bool found = false;
+
+	if (!client->stats_notify)
+		return false;
+
+	spin_lock_irq(&stats->lock);
+	if (stats->seq) {
+		*out = stats->snap;
+		client->stats_seen = stats->seq;
+		found = true;
+	}
+	spin_unlock_irq(&stats->lock);
+
+	return found;
+}
+
+/* vcam_async_complete
+ *
+ * Record a finished request and notify pollers and eventfds.
+ * Called with async.lock held.
+ */
+static void vcam_async_complete(struct vcam_data *data, u32 id, int result)
+{
+	struct vcam_async *async = &data->async;
+	struct vcam_client *client;
+
+	async->done_id = id;
+	async->done_result = result;
+	async->done_seq++;
+
+	list_for_each_entry(client, &async->clients, node) {
+		if (client->eventfd)
+			eventfd_signal(client->eventfd, 1);
+	}
+	wake_up_interruptible(&async->wait);
+}
+
+/* vcam_state_program
+ *
+ * Program one FOV or mode request through the synchronous ioctl path,
+ * which also includes the settle time of the mode. Requests for the state
+ * the camera is already in return at once from there.
+ */
+static int vcam_state_program(struct vcam_data *data, unsigned int cmd, VCAMIOCTLASYNC *req)
+{
+	struct device *dev = data->dev;
+	VCAMIOCTLCAMMODE mode = { .eCamMode = req->eCamMode };
+	VCAMIOCTLFOV fov = { .fov = req->fov };
+	int ret;
+
+	if (!data->ops.do_iocontrol)
+		return -ENODEV;
+
+	if (cmd == IOCTL_CAM_SET_FOV)
+		return data->ops.do_iocontrol(dev, IOCTL_CAM_SET_FOV, (PUCHAR)&fov, NULL);
+	if (cmd == IOCTL_CAM_SET_CAMMODE)
+		return data->ops.do_iocontrol(dev, IOCTL_CAM_SET_CAMMODE, (PUCHAR)&mode, NULL);
+
+	if (req->eCamMode == VCAM_DRAFT && data->cam_mode == VCAM_DRAFT) {
+		if (!req->fov)
+			return 0;
+		return data->ops.do_iocontrol(dev, IOCTL_CAM_SET_FOV, (PUCHAR)&fov, NULL);
+	}
+
+	ret = data->ops.do_iocontrol(dev, IOCTL_CAM_SET_CAMMODE, (PUCHAR)&mode, NULL);
+	if (ret || req->eCamMode != VCAM_DRAFT || !req->fov || req->fov == data->fov)
+		return ret;
+
+	return data->ops.do_iocontrol(dev, IOCTL_CAM_SET_FOV, (PUCHAR)&fov, NULL);
+}
+
+/* vcam_state_implies
+ *
+ * Whether target leaves the camera in the state req asked for
+ */
+static bool vcam_state_implies(const VCAMIOCTLASYNC *target, const VCAMIOCTLASYNC *req)
+{
+	if (target->eCamMode != req->eCamMode)
+		return false;
+	return target->eCamMode != VCAM_DRAFT || !req->fov || req->fov == target->fov;
+}
+
+/* vcam_state_merge
+ *
+ * Fold a new request into the target of the requests still waiting.
+ * Waiters whose state the new target does not reach fail with -EAGAIN.
+ * Called with arb.slock held.
+ */
+static void vcam_state_merge(struct vcam_arb *arb, struct vcam_arb_waiter *self)
+{
+	struct vcam_arb_waiter *w, *tmp;
+
+	/* the waiting target already reaches the state asked for */
+	if (!list_empty(&arb->waiters) && vcam_state_implies(&arb->target, &self->req)) {
+		list_add_tail(&self->node, &arb->waiters);
+		return;
+	}
+
+	list_for_each_entry_safe(w, tmp, &arb->waiters, node) {
+		if (vcam_state_implies(&self->req, &w->req))
+			continue;
+		list_del_init(&w->node);
+		w->result = -EAGAIN;
+		w->done = true;
+	}
+
+	arb->target_cmd = self->cmd;
+	arb->target = self->req;
+	list_add_tail(&self->node, &arb->waiters);
+}
+
+/* vcam_state_request
+ *
+ * Change FOV or camera mode on behalf of cmd. Requests that arrive while
+ * another change is being programmed merge, only the final state is
+ * programmed once and every merged request returns its result. A request
+ * interrupted while waiting may still be applied with a later one.
+ *
+ * Returns 0 on success
+ *         -ERESTARTSYS if interrupted while waiting
+ *         -EAGAIN if superseded by a request for another state
+ *         other from the sensor driver
+ */
+static int vcam_state_request(struct vcam_data *data, unsigned int cmd, const VCAMIOCTLASYNC *req)
+{
+	struct vcam_arb *arb = &data->arb;
+	struct vcam_arb_waiter self = { .cmd = cmd, .req = *req };
+	struct vcam_arb_waiter *w, *tmp;
+	VCAMIOCTLASYNC target;
+	unsigned int target_cmd;
+	LIST_HEAD(merged);
+	int ret;
+
+	spin_lock(&arb->slock);
+	vcam_state_merge(arb, &self);
+	arb->requests++;
+	spin_unlock(&arb->slock);
+
+	if (mutex_lock_interruptible(&arb->lock)) {
+		spin_lock(&arb->slock);
+		if (!self.done)
+			list_del(&self.node);
+		spin_unlock(&arb->slock);
+		return -ERESTARTSYS;
+	}
+
+	spin_lock(&arb->slock);
+	if (self.done) {
+		/* programmed or superseded by another request while we waited */
+		arb->coalesced++;
+		spin_unlock(&arb->slock);
+		mutex_unlock(&arb->lock);
+		return self.result;
+	}
+	target_cmd = arb->target_cmd;
+	target = arb->target;
+	list_splice_init(&arb->waiters, &merged);
+	spin_unlock(&arb->slock);
+
+	ret = vcam_state_program(data, target_cmd, &target);
+
+	spin_lock(&arb->slock);
+	list_for_each_entry_safe(w, tmp, &merged, node) {
+		list_del_init(&w->node);
+		w->result = ret;
+		w->done = true;
+	}
+	spin_unlock(&arb->slock);
+	mutex_unlock(&arb->lock);
+
+	return ret;
+}
+
+/* vcam_async_run
+ *
+ * Apply one queued mode switch, merged with synchronous requests
+ */
+static int vcam_async_run(struct vcam_data *data, VCAMIOCTLASYNC *req)
+{
+	return vcam_state_request(data, IOCTL_CAM_ASYNC_SWITCH, req);
+}
+
+static void vcam_async_work(struct kthread_work *work)
+{
+	struct vcam_data *data = container_of(to_vcam_work(work), struct vcam_data, async.work);
+	struct vcam_async *async = &data->async;
+	VCAMIOCTLASYNC req;
+	u32 id;
+	int ret;
+
+	vcam_work_start(data, to_vcam_work(work));
+
+	spin_lock_irq(&async->lock);
+	while (async->pending_id) {
+		req = async->pending;
+		id = async->pending_id;
+		async->pending_id = 0;
+		async->running_id = id;
+		spin_unlock_irq(&async->lock);
+
+		ret = vcam_async_run(data, &req);
+
+		spin_lock_irq(&async->lock);
+		async->running_id = 0;
+		vcam_async_complete(data, id, ret);
+	}
+	spin_unlock_irq(&async->lock);
+}
+
+/* vcam_async_submit
+ *
+ * Queue a mode switch and return its id in req->requestId. A request that
+ * has not started yet is superseded and completed with -ECANCELED.
+ */
+static int vcam_async_submit(struct vcam_data *data, VCAMIOCTLASYNC *req)
+{
+	struct vcam_async *async = &data->async;
+
+	if (req->eCamMode != VCAM_DRAFT && req->eCamMode != VCAM_STILL)
+		return -EINVAL;
+
+	spin_lock_irq(&async->lock);
+	if (async->pending_id)
+		vcam_async_complete(data, async->pending_id, -ECANCELED);
+
+	if (++async->next_id == 0)
+		async->next_id = 1;
+	req->requestId = async->next_id;
+	async->pending = *req;
+	async->pending_id = req->requestId;
+	spin_unlock_irq(&async->lock);
+
+	vcam_queue_work(data, &async->work, 0);
+	return 0;
+}
+
+/* vcam_async_cancel
+ *
+ * Cancel the queued request if it matches id, or whatever is queued if id
+ * is 0. A request that is already being applied can not be cancelled.
+ */
+static int vcam_async_cancel(struct vcam_data *data, u32 id)
+{
+	struct vcam_async *async = &data->async;
+	int ret = -ENOENT;
+
+	spin_lock_irq(&async->lock);
+	if (async->pending_id && (!id || id == async->pending_id)) {
+		vcam_async_complete(data, async->pending_id, -ECANCELED);
+		async->pending_id = 0;
+		ret = 0;
+	} else if (id && id == async->running_id) {
+		ret = -EBUSY;
+	}
+	spin_unlock_irq(&async->lock);
+
+	return ret;
+}
+
+static void vcam_async_status(struct vcam_client *client, VCAMIOCTLASYNCSTATUS *status)
+{
+	struct vcam_async *async = &client->data->async;
+
+	spin_lock_irq(&async->lock);
+	status->pendingId = async->pending_id;
+	status->runningId = async->running_id;
+	status->completedId = async->done_id;
+	status->result = async->done_result;
+	client->done_seen = async->done_seq;
+	spin_unlock_irq(&async->lock);
+}
+
+static int vcam_set_eventfd(struct vcam_client *client, int fd)
+{
+	struct vcam_async *async = &client->data->async;
+	struct eventfd_ctx *ctx = NULL, *old;
+
+	if (fd >= 0) {
+		ctx = eventfd_ctx_fdget(fd);
+		if (IS_ERR(ctx))
+			return PTR_ERR(ctx);
+	}
+
+	spin_lock_irq(&async->lock);
+	old = client->eventfd;
+	client->eventfd = ctx;
+	spin_unlock_irq(&async->lock);
+
+	if (old)
+		eventfd_ctx_put(old);
+	return 0;
+}
+
+/* vcam_work_init
+ *
+ * Prepare a work item for the sensor worker
+ */
+void vcam_work_init(struct vcam_work *work, kthread_work_func_t fn)
+{
+	kthread_init_delayed_work(&work->dwork, fn);
+}
+
+/* vcam_queue_work
+ *
+ * Queue work on the sensor worker after delay jiffies, unless it is
+ * already pending.
+ *
+ * Returns true if queued, false if already pending
+ */
+bool vcam_queue_work(struct vcam_data *data, struct vcam_work *work, unsigned long delay)
+{
+	struct vcam_worker *worker = &data->worker;
+	u64 due = ktime_get_ns() + jiffies_to_nsecs(delay);
+	unsigned long flags;
+	bool queued;
+
+	spin_lock_irqsave(&worker->lock, flags);
+	queued = kthread_queue_delayed_work(worker->kworker, &work->dwork, delay);
+	if (queued) {
+		work->due_ns = due;
+		worker->depth_max = max(worker->depth_max, ++worker->depth);
+	}
+	spin_unlock_irqrestore(&worker->lock, flags);
+
+	return queued;
+}
+
+/* vcam_mod_work
+ *
+ * Queue work on the sensor worker after delay jiffies, moving it if it
+ * is already pending
+ */
+void vcam_mod_work(struct vcam_data *data, struct vcam_work *work, unsigned long delay)
+{
+	struct vcam_worker *worker = &data->worker;
+	u64 due = ktime_get_ns() + jiffies_to_nsecs(delay);
+	unsigned long flags;
+
+	spin_lock_irqsave(&worker->lock, flags);
+	work->due_ns = due;
+	/* false if it was idle and is queued now */
+	if (!kthread_mod_delayed_work(worker->kworker, &work->dwork, delay))
+		worker->depth_max = max(worker->depth_max, ++worker->depth);
+	spin_unlock_irqrestore(&worker->lock, flags);
+}
+
+/* vcam_cancel_work_sync
+ *
+ * Cancel pending work and wait for a running instance to finish
+ */
+void vcam_cancel_work_sync(struct vcam_data *data, struct vcam_work *work)
+{
+	struct vcam_worker *worker = &data->worker;
+
+	if (kthread_cancel_delayed_work_sync(&work->dwork)) {
+		spin_lock_irq(&worker->lock);
+		worker->depth--;
+		spin_unlock_irq(&worker->lock);
+	}
+}
+
+/* vcam_work_start
+ *
+ * Account a started work item, called first by every work function. The
+ * latency is the time from when the work was due until it started.
+ */
+void vcam_work_start(struct vcam_data *data, struct vcam_work *work)
+{
+	struct vcam_worker *worker = &data->worker;
+	u64 now = ktime_get_ns();
+	u64 latency;
+
+	spin_lock_irq(&worker->lock);
+	latency = now > work->due_ns ? now - work->due_ns : 0;
+	worker->depth--;
+	worker->runs++;
+	if (!worker->latency_ns)
+		worker->latency_ns = latency;
+	else
+		worker->latency_ns = worker->latency_ns - (worker->latency_ns >> 3) + (latency >> 3);
+	worker->latency_max_ns = max(worker->latency_max_ns, latency);
+	spin_unlock_irq(&worker->lock);
+}
+
+static ssize_t worker_stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct vcam_worker *worker = &data->worker;
+	u64 runs, latency, latency_max;
+	int depth, depth_max;
+
+	spin_lock_irq(&worker->lock);
+	runs = worker->runs;
+	depth = worker->depth;
+	depth_max = worker->depth_max;
+	latency = worker->latency_ns;
+	latency_max = worker->latency_max_ns;
+	spin_unlock_irq(&worker->lock);
+
+	return sysfs_emit(buf, "runs %llu depth %d max_depth %d latency_us %llu max_latency_us %llu\n",
+			  runs, depth, depth_max, div_u64(latency, NSEC_PER_USEC),
+			  div_u64(latency_max, NSEC_PER_USEC));
+}
+
+/* writing anything resets the maximum values */
+static ssize_t worker_stats_store(struct device *dev, struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	struct vcam_worker *worker = &data->worker;
+
+	spin_lock_irq(&worker->lock);
+	worker->depth_max = worker->depth;
+	worker->latency_max_ns = 0;
+	spin_unlock_irq(&worker->lock);
+	return count;
+}
+
+static DEVICE_ATTR_RW(worker_stats);
+
+static ssize_t arb_stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct vcam_data *data = dev_get_drvdata(dev);
+	u64 requests, coalesced;
+
+	spin_lock(&data->arb.slock);
+	requests = data->arb.requests;
+	coalesced = data->arb.coalesced;
+	spin_unlock(&data->arb.slock);
+
+	return sysfs_emit(buf, "requests %llu coalesced %llu\n", requests, coalesced);
+}
+
+static DEVICE_ATTR_RO(arb_stats);
+
+/* vcam_worker_init
+ *
+ * Create the sensor worker thread, SCHED_FIFO and bound to a CPU as given
+ * by the module parameters
+ *
+ * Returns 0 on success
+ *         negative on error
+ */
+static int vcam_worker_init(struct vcam_data *data)
+{
+	struct device *dev = data->dev;
+	struct kthread_worker *kworker;
+
+	spin_lock_init(&data->worker.lock);
+
+	if (worker_cpu >= 0 && worker_cpu < nr_cpu_ids && cpu_online(worker_cpu)) {
+		kworker = kthread_create_worker_on_cpu(worker_cpu, 0, "vcam/%d", worker_cpu);
+	} else {
+		if (worker_cpu >= 0)
+			dev_warn(dev, "CPU %d not available, sensor worker not bound\n", worker_cpu);
+		kworker = kthread_create_worker(0, "vcam");
+	}
+	if (IS_ERR(kworker))
+		return PTR_ERR(kworker);
+
+	if (worker_fifo)
+		sched_set_fifo(kworker->task);
+
+	data->worker.kworker = kworker;
+	return 0;
+}
+
 static int vcam_probe(struct platform_device *pdev)
 {
 	int ret;
@@ -36,19 +772,41 @@ static int vcam_probe(struct platform_device *pdev)
 		return -ENODEV;
 	}
 
+	data->status = (VCAMSTATUS *)devm_get_free_pages(dev, GFP_KERNEL | __GFP_ZERO, 0);
+	if (!data->status)
+		return -ENOMEM;
+	data->status->version = VCAM_STATUS_VERSION;
+	spin_lock_init(&data->status_lock);
+
+	data->dev = dev;
+	ret = vcam_worker_init(data);
+	if (ret)
+		return ret;
+	vcam_work_init(&data->async.work, vcam_async_work);
+	spin_lock_init(&data->async.lock);
+	init_waitqueue_head(&data->async.wait);
+	INIT_LIST_HEAD(&data->async.clients);
+
+	atomic_set(&data->stats.users, 0);
+	spin_lock_init(&data->stats.lock);
+	init_waitqueue_head(&data->stats.wait);
+	spin_lock_init(&data->ctrl.lock);
+	mutex_init(&data->arb.lock);
+	spin_lock_init(&data->arb.slock);
+	INIT_LIST_HEAD(&data->arb.waiters);
+
 	data->miscdev.minor = MISC_DYNAMIC_MINOR;
 	data->miscdev.name = devm_kasprintf(dev, GFP_KERNEL, "vcam0");
 	data->miscdev.fops = &vcam_fops;
 	data->miscdev.parent = dev;
 
-	data->dev = dev;
 	dev_set_drvdata(dev, data);
 	platform_set_drvdata(pdev, data);
 
 	ret = misc_register(&data->miscdev);
 	if (ret) {
 		dev_err(dev, "Failed to register miscdev for VCAM driver (error %i\n)\n", ret);
-		return ret;
+		goto err_misc;
 	}
 
 	// initialize this device instance
@@ -65,10 +823,19 @@ static int vcam_probe(struct platform_device *pdev)
 		goto err_init_failed;
 	}
 
-	return ret;
+	ret = device_create_file(dev, &dev_attr_worker_stats);
+	if (ret)
+		dev_warn(dev, "Failed to add worker_stats (%i)\n", ret);
+	ret = device_create_file(dev, &dev_attr_arb_stats);
+	if (ret)
+		dev_warn(dev, "Failed to add arb_stats (%i)\n", ret);
+
+	return 0;
 
 err_init_failed:
 	misc_deregister(&data->miscdev);
+err_misc:
+	kthread_destroy_worker(data->worker.kworker);
 	return ret;
 }
 
@@ -77,10 +844,25 @@ static int vcam_remove(struct platform_device *pdev)
 	struct device *dev = &pdev->dev;
 	struct vcam_data *data = dev_get_drvdata(dev);
 
+	device_remove_file(dev, &dev_attr_arb_stats);
+	device_remove_file(dev, &dev_attr_worker_stats);
+	misc_deregister(&data->miscdev);
+	vcam_async_cancel(data, 0);
+
+	/* remove every path that can queue work before the worker goes */
 	if (data->ops.deinitialize_hw)
 		data->ops.deinitialize_hw(dev);
 
-	misc_deregister(&data->miscdev);
+	vcam_cancel_work_sync(data, &data->async.work);
+	vcam_cancel_work_sync(data, &data->still_revert_work);
+	vcam_cancel_work_sync(data, &data->ae_release_work);
+	vcam_cancel_work_sync(data, &data->nightmode_work);
+	vcam_cancel_work_sync(data, &data->flash_work);
+	kthread_destroy_worker(data->worker.kworker);
+
+	/* no work can touch the sensor or the I2C adapter any more */
+	if (data->ops.release_hw)
+		data->ops.release_hw(dev);
 
 	return 0;
 }
@@ -133,8 +915,10 @@ static long vcam_iocontrol(struct file *filep, unsigned int cmd, unsigned long a
 {
 	int ret;
 	char *tmp;
-	struct vcam_data *data = container_of(filep->private_data, struct vcam_data, miscdev);
+	struct vcam_client *client = filep->private_data;
+	struct vcam_data *data = client->data;
 	struct device *dev = data->dev;
+	VCAMIOCTLASYNC req;
 
 	tmp = kzalloc(_IOC_SIZE(cmd), GFP_KERNEL);
 	if (!tmp)
@@ -149,7 +933,37 @@ static long vcam_iocontrol(struct file *filep, unsigned int cmd, unsigned long a
 		}
 	}
 
+	if (vcam_changes_state(cmd)) {
+		ret = vcam_prio_check(client);
+		if (ret)
+			goto err_out;
+	}
+
 	switch (cmd) {
+	case IOCTL_CAM_SET_FOV:
+		req.eCamMode = VCAM_DRAFT;
+		req.fov = ((VCAMIOCTLFOV *)tmp)->fov;
+		ret = vcam_state_request(data, cmd, &req);
+		break;
+
+	case IOCTL_CAM_SET_CAMMODE:
+		req.eCamMode = ((VCAMIOCTLCAMMODE *)tmp)->eCamMode;
+		req.fov = 0;
+		if (req.eCamMode == VCAM_DRAFT || req.eCamMode == VCAM_STILL)
+			ret = vcam_state_request(data, cmd, &req);
+		else if (data->ops.do_iocontrol)
+			ret = data->ops.do_iocontrol(dev, cmd, tmp, (PUCHAR)arg);
+		break;
+
+	case IOCTL_CAM_SET_PRIORITY:
+		ret = vcam_prio_set(client, ((VCAMIOCTLPRIORITY *)tmp)->priority);
+		break;
+
+	case IOCTL_CAM_GET_PRIORITY:
+		((VCAMIOCTLPRIORITY *)tmp)->priority = client->priority;
+		ret = 0;
+		break;
+
 	case IOCTL_CAM_GET_FLASH:
 		down(&data->sem);
 		if (data->ops.get_torchstate)
@@ -163,6 +977,36 @@ static long vcam_iocontrol(struct file *filep, unsigned int cmd, unsigned long a
 		ret = ERROR_SUCCESS;
 		up(&data->sem);
 		break;
+
+	case IOCTL_CAM_ASYNC_SWITCH:
+		ret = vcam_async_submit(data, (VCAMIOCTLASYNC *)tmp);
+		break;
+
+	case IOCTL_CAM_ASYNC_CANCEL:
+		ret = vcam_async_cancel(data, ((VCAMIOCTLASYNC *)tmp)->requestId);
+		break;
+
+	case IOCTL_CAM_ASYNC_STATUS:
+		vcam_async_status(client, (VCAMIOCTLASYNCSTATUS *)tmp);
+		ret = 0;
+		break;
+
+	case IOCTL_CAM_SET_EVENTFD:
+		ret = vcam_set_eventfd(client, ((VCAMIOCTLEVENTFD *)tmp)->fd);
+		break;
+
+	case IOCTL_CAM_SET_STATS_NOTIFY:
+		vcam_stats_notify(client, ((VCAMIOCTLSTATSNOTIFY *)tmp)->bEnable);
+		ret = 0;
+		break;
+
+	case IOCTL_CAM_GET_STATS:
+		if (vcam_stats_cached(client, (VCAMIOCTLSTATS *)tmp))
+			ret = 0;
+		else if (data->ops.do_iocontrol)
+			ret = data->ops.do_iocontrol(dev, cmd, tmp, (PUCHAR)arg);
+		break;
+
 	default:
 		if (data->ops.do_iocontrol)
 			ret = data->ops.do_iocontrol(dev, cmd, tmp, (PUCHAR)arg);